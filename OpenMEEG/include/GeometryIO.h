@@ -61,6 +61,7 @@ namespace OpenMEEG {
         virtual const char* name() const = 0;
 
         void load(Geometry& geometry) {
+            geometry.input_files.push_back(fname);
             load_meshes(geometry);
             load_domains(geometry);
         }
@@ -42,6 +42,9 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <fstream>
 #include <map>
 #include <string>
+#include <vector>
+
+#include <TextParsing.H>
 
 #include <triangle.h>
 #include <mesh.h>
@@ -122,6 +125,26 @@ namespace OpenMEEG {
 
         void reference_vertices(Mesh& mesh) const { mesh.reference_vertices(indmap); }
 
+        //  Parse count lines of width numbers starting at the current position of the stream with the
+        //  parallel text parser. On success, the stream is moved after these lines. Otherwise, it is left
+        //  untouched and the caller falls back on stream parsing.
+
+        template <typename T>
+        bool parse_block(const unsigned count,const unsigned width,std::vector<T>& values,const char comment='\0') {
+            const std::streamoff pos = fs.tellg();
+            const maths::MappedFile file(fname);
+            if (pos<0 || !file.is_open() || static_cast<std::size_t>(pos)>file.size())
+                return false;
+
+            values.resize(static_cast<std::size_t>(count)*width);
+            const char* next = maths::text::parse_records(file.begin()+pos,file.end(),count,width,values.data(),comment);
+            if (next==nullptr)
+                return false;
+
+            fs.seekg(next-file.begin());
+            return true;
+        }
+
         static Registery registery;
 
         MeshIO(const std::string& filename,const char* name): fname(filename) { registery.insert({ name, this }); }
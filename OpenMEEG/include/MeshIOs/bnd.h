@@ -41,6 +41,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <IOUtils.H>
 #include <om_utils.h>
@@ -75,10 +76,17 @@ namespace OpenMEEG::MeshIOs {
             om_error(st == "Positions");
 
             Vertices vertices;
-            for (unsigned i=0; i<npts; ++i) {
-                Vertex v;
-                fs >> io_utils::skip_comments('#') >> v;
-                vertices.push_back(v);
+            std::vector<double> values;
+            if (parse_block(npts,3,values,'#')) {
+                vertices.reserve(npts);
+                for (unsigned i=0; i<npts; ++i)
+                    vertices.push_back(Vertex(values[3*i],values[3*i+1],values[3*i+2]));
+            } else {
+                for (unsigned i=0; i<npts; ++i) {
+                    Vertex v;
+                    fs >> io_utils::skip_comments('#') >> v;
+                    vertices.push_back(v);
+                }
             }
             indmap = geom.add_vertices(vertices);
         }
@@ -102,6 +110,13 @@ namespace OpenMEEG::MeshIOs {
             om_error(st=="Polygons");
 
             mesh.triangles().reserve(ntrgs);
+            std::vector<unsigned> indices;
+            if (parse_block(ntrgs,3,indices,'#')) {
+                for (unsigned i=0; i<ntrgs; ++i)
+                    mesh.add_triangle(TriangleIndices(indices[3*i],indices[3*i+1],indices[3*i+2]),indmap);
+                return;
+            }
+
             for (unsigned i=0; i<ntrgs; ++i) {
                 TriangleIndices t;
                 fs >> io_utils::skip_comments('#') >> t[0] >> t[1] >> t[2];
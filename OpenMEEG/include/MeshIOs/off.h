@@ -44,6 +44,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <om_utils.h>
 #include <MeshIO.h>
@@ -72,10 +73,17 @@ namespace OpenMEEG::MeshIOs {
             fs >> ntriangles >> trash;
             
             Vertices vertices;
-            for (unsigned i=0; i<npts; ++i) {
-                Vertex v;
-                fs >> v;
-                vertices.push_back(v);
+            std::vector<double> values;
+            if (parse_block(npts,3,values)) {
+                vertices.reserve(npts);
+                for (unsigned i=0; i<npts; ++i)
+                    vertices.push_back(Vertex(values[3*i],values[3*i+1],values[3*i+2]));
+            } else {
+                for (unsigned i=0; i<npts; ++i) {
+                    Vertex v;
+                    fs >> v;
+                    vertices.push_back(v);
+                }
             }
             indmap = geom.add_vertices(vertices);
         }
@@ -84,6 +92,13 @@ namespace OpenMEEG::MeshIOs {
             reference_vertices(mesh);
 
             mesh.triangles().reserve(ntriangles);
+            std::vector<unsigned> indices;
+            if (parse_block(ntriangles,4,indices)) {
+                for (unsigned i=0; i<ntriangles; ++i)
+                    mesh.add_triangle(TriangleIndices(indices[4*i+1],indices[4*i+2],indices[4*i+3]),indmap);
+                return;
+            }
+
             for (unsigned i=0; i<ntriangles; ++i) {
                 unsigned trash;
                 TriangleIndices t;
@@ -41,6 +41,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <om_utils.h>
 #include <MeshIO.h>
@@ -61,11 +62,18 @@ namespace OpenMEEG::MeshIOs {
             fs >> ch >> npts;
 
             Vertices vertices;
-            for (unsigned i=0; i<npts; ++i) {
-                Vertex v;
-                Normal n;
-                fs >> v >> n;
-                vertices.push_back(v);
+            std::vector<double> values;
+            if (parse_block(npts,6,values)) {
+                vertices.reserve(npts);
+                for (unsigned i=0; i<npts; ++i)
+                    vertices.push_back(Vertex(values[6*i],values[6*i+1],values[6*i+2]));
+            } else {
+                for (unsigned i=0; i<npts; ++i) {
+                    Vertex v;
+                    Normal n;
+                    fs >> v >> n;
+                    vertices.push_back(v);
+                }
             }
             indmap = geom.add_vertices(vertices);
         }
@@ -78,6 +86,13 @@ namespace OpenMEEG::MeshIOs {
             fs >> ch >> ntrgs >> ntrgs >> ntrgs; // This number is repeated 3 times
 
             mesh.triangles().reserve(ntrgs);
+            std::vector<unsigned> indices;
+            if (parse_block(ntrgs,3,indices)) {
+                for (unsigned i=0; i<ntrgs; ++i)
+                    mesh.add_triangle(TriangleIndices(indices[3*i],indices[3*i+1],indices[3*i+2]),indmap);
+                return;
+            }
+
             for (unsigned i=0; i<ntrgs; ++i) {
                 TriangleIndices t;
                 fs >> t[0] >> t[1] >> t[2];
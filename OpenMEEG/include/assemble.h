@@ -39,24 +39,123 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include <vector.h>
 #include <matrix.h>
 #include <symmatrix.h>
+#include <shifted_solver.h>
 #include <geometry.h>
 #include <sensors.h>
+#include <rectilinear_grid.h>
+#include <progressbar.h>
 
 #include <sparse_matrix.h>
 
 namespace OpenMEEG {
 
+    class HeadMatBlocks;
+
     class OPENMEEG_EXPORT HeadMat: public SymMatrix {
     public:
         HeadMat(const Geometry& geo,const unsigned gauss_order=3);
+
+        /// Assembly with checkpointing of the completed blocks in checkpoint_file. With resume, the blocks
+        /// found in a valid checkpoint file are not recomputed.
+
+        HeadMat(const Geometry& geo,const unsigned gauss_order,const std::string& checkpoint_file,const bool resume=false);
+
+        /// Head matrix for the conductivities of geo obtained by recombining precomputed blocks.
+
+        HeadMat(const Geometry& geo,const HeadMatBlocks& blocks);
+
         virtual ~HeadMat() { };
     };
 
+    /// \brief Conductivity independent parts of the head matrix.
+    /// The head matrix is D+sum_p (a_p S_p + b_p N_p) where p runs over the pairs of communicating meshes,
+    /// S_p and N_p are the single layer and hypersingular blocks of the pair, and D gathers the double layer
+    /// blocks (whose coefficients only depend on the geometry). a_p and b_p are the only terms depending on
+    /// the conductivities (see conductivity_coefficients). Storing D, S_p and N_p allows to build the head
+    /// matrix for new conductivities without any integration (the set of non-conductive domains must not change).
+    /// The blocks are identified by a hash of the geometry (without the conductivity values) and of the
+    /// integration order, and they are rejected (std::invalid_argument) for any other geometry.
+
+    class OPENMEEG_EXPORT HeadMatBlocks {
+    public:
+
+        HeadMatBlocks() { }
+        HeadMatBlocks(const Geometry& geo,const unsigned gauss_order=3);
+
+        /// Head matrix for the conductivities of geo.
+
+        SymMatrix operator()(const Geometry& geo) const;
+
+        size_t size() const { return D.nlin(); }
+
+        void save(const std::string& filename) const;
+
+        /// Load blocks saved for geo and gauss_order.
+
+        void load(const std::string& filename,const Geometry& geo,const unsigned gauss_order=3);
+
+    private:
+
+        friend class ConductivitySweep;
+
+        void check(const Geometry& geo) const;
+
+        struct Block {
+            std::string mesh1;
+            std::string mesh2;
+            Matrix      S;  ///< Triangles of mesh1 x triangles of mesh2 (empty for current barriers).
+            Matrix      N;  ///< Vertices of mesh1 x vertices of mesh2.
+        };
+
+        const Block& block(const Geometry& geo,const unsigned i) const;
+
+        unsigned           gauss_order = 3;
+        uint64_t           id          = 0;  ///< Hash of the geometry and of gauss_order.
+        SymMatrix          D;
+        std::vector<Block> blocks;
+    };
+
+    /// Coefficients (a_p,b_p) of the S and N blocks of each communicating mesh pair for the conductivities of geo.
+
+    OPENMEEG_EXPORT Matrix conductivity_coefficients(const Geometry& geo);
+
+    /// \brief Solutions of H(sigma)X = B when the conductivity sigma of one domain varies, the other conductivities
+    /// being fixed. Only the blocks of the mesh pairs bounding the domain depend on sigma. Denoting by a the unknowns
+    /// of these meshes and by u the other ones, u is eliminated once: the Schur complement H_aa-H_au H_uu^{-1} H_ua
+    /// only changes by (1/sigma-1/sigma0) S_d+(sigma-sigma0) N_d, where S_d and N_d gather the blocks of the domain.
+    /// Multiplied by sigma, it is a quadratic matrix polynomial in sigma, which is linearized and reduced to the
+    /// Hessenberg form once (see ShiftedSolver). Each new conductivity then costs O(|a|^2) operations per right hand
+    /// side, without any factorization. For lead fields, B is the transposed sensor matrix (adjoint method).
+
+    class OPENMEEG_EXPORT ConductivitySweep {
+    public:
+
+        ConductivitySweep(const Geometry& geo,const HeadMatBlocks& blocks,const std::string& domain_name,const Matrix& B);
+
+        /// Solution X of H(sigma)X = B.
+
+        Matrix solve(const double sigma) const;
+
+        size_t nb_updated_unknowns() const { return affected.size(); }
+
+    private:
+
+        std::vector<size_t> affected; ///< Unknowns a.
+        std::vector<size_t> others;   ///< Unknowns u.
+
+        const double sigma0;
+
+        ShiftedSolver pencil; ///< L0^{-1} R and L0^{-1} [B_a-H_au H_uu^{-1} B_u;0] for the linearization P+sigma R of sigma S(sigma).
+        Matrix        Z;      ///< H_uu^{-1} H_ua.
+        Matrix        Y;      ///< H_uu^{-1} B_u.
+    };
+
     class OPENMEEG_EXPORT SurfSourceMat: public Matrix {
     public:
         SurfSourceMat(const Geometry& geo,Mesh& sources,const unsigned gauss_order=3);
@@ -67,7 +166,18 @@ namespace OpenMEEG {
     public:
         DipSourceMat(const Geometry& geo,const Matrix& dipoles,const unsigned gauss_order=3,
                      const bool adapt_rhs=true,const std::string& domain_name="");
+
+        /// Same, reporting the progress in pb (which may be shared by several blocks of dipoles).
+
+        DipSourceMat(const Geometry& geo,const Matrix& dipoles,ProgressBar& pb,const unsigned gauss_order=3,
+                     const bool adapt_rhs=true,const std::string& domain_name="");
+
         virtual ~DipSourceMat() { };
+
+    private:
+
+        void assemble(const Geometry& geo,const Matrix& dipoles,ProgressBar& pb,const unsigned gauss_order,
+                      const bool adapt_rhs,const std::string& domain_name);
     };
 
     class OPENMEEG_EXPORT EITSourceMat: public Matrix {
@@ -76,10 +186,15 @@ namespace OpenMEEG {
         virtual ~EITSourceMat() { }
     };
 
+    //  If theta is positive, the contributions of the triangles seen from a point with an opening angle
+    //  (triangle radius/distance) smaller than theta are computed with a Gauss rule instead of analytically.
+    //  With a rectilinear grid, the lines of the points in non-conductive domains are zero (instead of dropped).
+
     class OPENMEEG_EXPORT Surf2VolMat: public Matrix {
     public:
         using Matrix::operator=;
-        Surf2VolMat(const Geometry& geo,const Matrix& points);
+        Surf2VolMat(const Geometry& geo,const Matrix& points,const double theta=0.0);
+        Surf2VolMat(const Geometry& geo,const RectilinearGrid& grid,const double theta=0.0);
         virtual ~Surf2VolMat() { }
     };
 
@@ -99,15 +214,25 @@ namespace OpenMEEG {
         virtual ~Head2ECoGMat() { }
     };
 
+    //  If theta is positive, the contributions of the mesh vertices seen from a sensor with an opening angle
+    //  (cluster radius/distance) smaller than theta are computed with a far field (multipole) approximation.
+
     class OPENMEEG_EXPORT Head2MEGMat: public Matrix {
     public:
-        Head2MEGMat(const Geometry& geo,const Sensors& sensors);
+        Head2MEGMat(const Geometry& geo,const Sensors& sensors,const double theta=0.0);
+
+        /// Matrix for sensors which were re-registered, previous_mat being the matrix of previous_sensors.
+        /// Only the lines of the sensors whose integration points changed (or which are new) are computed.
+
+        Head2MEGMat(const Geometry& geo,const Sensors& sensors,const Sensors& previous_sensors,
+                    const Matrix& previous_mat,const double theta=0.0);
+
         virtual ~Head2MEGMat() { }
     };
 
     class OPENMEEG_EXPORT SurfSource2MEGMat: public Matrix {
     public:
-        SurfSource2MEGMat(const Mesh& sources,const Sensors& sensors);
+        SurfSource2MEGMat(const Mesh& sources,const Sensors& sensors,const double theta=0.0);
         virtual ~SurfSource2MEGMat() { }
     };
 
@@ -0,0 +1,95 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <OpenMEEG_Export.h>
+
+#include <symmatrix.h>
+#include <content_hash.h>
+
+namespace OpenMEEG {
+
+    /// \brief Sidecar file recording the blocks of a matrix assembly which are completed, so that an interrupted
+    /// assembly can be resumed. Each record contains a block number, the row and column indices of the block and
+    /// its values. Records are appended (and flushed) as soon as a block is completed, a partially written
+    /// record is ignored. The file is bound to the assembly inputs through a key.
+
+    class OPENMEEG_EXPORT AssemblyCheckpoint {
+    public:
+
+        typedef std::vector<size_t> Indices;
+
+        /// Open the checkpoint file. If resume is true and the file matches the key and the matrix size,
+        /// the recorded blocks are considered completed, otherwise a new checkpoint is started.
+
+        AssemblyCheckpoint(const std::string& filename,const ContentHash& key,const size_t size,const bool resume);
+
+        bool completed(const unsigned block) const { return done.count(block)!=0; }
+        size_t nb_completed() const { return done.size(); }
+
+        /// Copy the values of the recorded blocks into M (in the order they were recorded).
+
+        void restore(SymMatrix& M) const;
+
+        /// Record the block (rows x cols) of M.
+
+        void save(const unsigned block,const Indices& rows,const Indices& cols,const SymMatrix& M);
+
+    private:
+
+        std::streamoff scan();
+
+        template <typename Function>
+        std::streamoff read_records(std::ifstream& is,Function f) const;
+
+        const std::string       filename;
+        const ContentHash::Value key;
+        const uint64_t          size;
+
+        std::set<unsigned> done;
+        std::ofstream      os;
+    };
+}
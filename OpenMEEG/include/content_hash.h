@@ -0,0 +1,112 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace OpenMEEG {
+
+    /// \brief Incremental 64 bits FNV-1a hash used to identify the contents of inputs (files, parameters).
+    /// Data is consumed by 64 bits words, so that hashing large files is not slower than reading them.
+
+    class ContentHash {
+    public:
+
+        typedef uint64_t Value;
+
+        ContentHash(): value(14695981039346656037ULL) { }
+
+        void add(const void* data,const std::size_t n) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            std::size_t i = 0;
+            for (;i+sizeof(Value)<=n;i+=sizeof(Value)) {
+                Value word;
+                std::memcpy(&word,bytes+i,sizeof(word));
+                mix(word);
+            }
+            for (;i<n;++i)
+                mix(bytes[i]);
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type
+        add(const T& v) { add(&v,sizeof(T)); }
+
+        void add(const std::string& s) {
+            add(s.size());
+            add(s.data(),s.size());
+        }
+
+        /// Add the contents of a file. Returns false if the file cannot be read.
+
+        bool add_file(const std::string& name) {
+            std::ifstream ifs(name,std::ios::binary);
+            if (!ifs.is_open())
+                return false;
+            std::vector<char> buffer(1<<20);
+            while (ifs) {
+                ifs.read(buffer.data(),buffer.size());
+                add(buffer.data(),static_cast<std::size_t>(ifs.gcount()));
+            }
+            return true;
+        }
+
+        Value operator()() const { return value; }
+
+        std::string hex() const {
+            std::ostringstream oss;
+            oss << std::hex << std::setw(16) << std::setfill('0') << value;
+            return oss.str();
+        }
+
+    private:
+
+        void mix(const Value word) { value = (value^word)*1099511628211ULL; }
+
+        Value value;
+    };
+}
@@ -50,7 +50,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 namespace OpenMEEG {
 
-    double dist_point_cell(const Vect3&, const Triangle& , Vect3&, bool&);
+    OPENMEEG_EXPORT double dist_point_triangle(const Vect3&, const Triangle&, Vect3&, bool&);
     OPENMEEG_EXPORT double dist_point_interface(const Vect3&, const Interface&, Vect3&, Triangle&);
     OPENMEEG_EXPORT std::string dist_point_geom(const Vect3&, const Geometry&, Vect3&, Triangle&, double&);
 }
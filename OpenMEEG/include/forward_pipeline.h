@@ -0,0 +1,89 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <OpenMEEG_Export.h>
+
+#include <matrix.h>
+#include <geometry.h>
+#include <sensors.h>
+
+namespace OpenMEEG {
+
+    //  In-memory computation of dipole lead fields: the geometry is built once by the caller, and the
+    //  head matrix, the source matrix and the sensor matrices are assembled concurrently and never
+    //  written to disk (unless a spill directory is given). The head matrix is factorized once, the
+    //  adjoint systems for all the EEG and MEG sensors being solved together.
+
+    class OPENMEEG_EXPORT ForwardPipeline {
+    public:
+
+        struct Options {
+            unsigned    gauss_order     = 3;
+            bool        adapt_rhs       = true;
+            bool        mixed_precision = false;
+            std::string domain_name;     ///< Domain containing the dipoles (automatically found if empty).
+            std::string spill_directory; ///< If not empty, the intermediate matrices are also saved there.
+        };
+
+        ForwardPipeline(const Geometry& geo): geometry(geo) { }
+        ForwardPipeline(const Geometry& geo,const Options& opts): geometry(geo),options(opts) { }
+
+        /// Compute the lead fields of the dipoles. A null sensor pointer disables the corresponding modality.
+
+        void compute(const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids);
+
+        const Matrix& eeg() const { return EEGleadfield; }
+        const Matrix& meg() const { return MEGleadfield; }
+
+    private:
+
+        template <typename MATRIX>
+        void spill(const MATRIX& M,const std::string& name) const;
+
+        const Geometry& geometry;
+        const Options   options;
+
+        Matrix EEGleadfield;
+        Matrix MEGleadfield;
+    };
+}
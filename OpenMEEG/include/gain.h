@@ -39,12 +39,17 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <algorithm>
+
 #include "matrix.h"
 #include "sparse_matrix.h"
 #include "symmatrix.h"
+#include "mixed_precision.h"
 #include "geometry.h"
 #include "progressbar.h"
 #include "assemble.h"
+#include "matrix_cache.h"
+#include "instrumentation.h"
 
 #define USE_GMRES 0
 #if USE_GMRES
@@ -58,7 +63,7 @@ namespace OpenMEEG {
     // Consider the GMRes solver for problems with dimension>15,000 (3,000 vertices per interface)
 
     template <typename MATRIX>
-    Matrix linsolve(const SymMatrix& H,const MATRIX& S) {
+    Matrix linsolve(const SymMatrix& H,const MATRIX& S,const bool=false) {
         Matrix res(S.nlin(),H.nlin());
         Jacobi<SymMatrix> M(H);    // Jacobi preconditionner
         #pragma omp parallel for
@@ -76,14 +81,68 @@ namespace OpenMEEG {
         return res
     }
 #else
+    namespace Details {
+
+        // With mixed_precision, H is factorized in single precision and the solution is refined
+        // against H (in double precision). Falls back to the double precision solver if the single precision
+        // factorization fails or if the refinement does not converge.
+        // B contains the right hand sides and is overwritten by the solutions.
+
+        inline void solve(const SymMatrix& H,Matrix& B,const bool mixed_precision) {
+            const ScopedTimer timer("solve");
+            if (mixed_precision) {
+                const MixedPrecisionSolver solver(H);
+                if (solver.solve(B)) {
+                    std::cout << "Mixed precision solve: " << solver.iterations() << " refinement step(s)." << std::endl;
+                    return;
+                }
+                std::cout << "Mixed precision solve failed, using double precision." << std::endl;
+            }
+            H.solveLin(B); // solving the system AX=B with LAPACK
+        }
+
+        // B contains the transposed selection matrix and is overwritten.
+
+        inline Matrix linsolve(const SymMatrix& H,Matrix& B,const bool mixed_precision) {
+            solve(H,B,mixed_precision);
+            return B.transpose();
+        }
+    }
+
+    //  As the adjoint solution only depends on H and S, it is kept in the matrix cache (when enabled),
+    //  so that the factorization of H is skipped when only the sources change.
+
     template <typename SelectionMatrix>
-    Matrix linsolve(const SymMatrix& H,const SelectionMatrix& S) {
+    Matrix linsolve(const SymMatrix& H,const SelectionMatrix& S,const bool mixed_precision=false) {
         Matrix res(S.transpose());
-        H.solveLin(res); // solving the system AX=B with LAPACK
-        return res.transpose();
+        MatrixCache cache("AdjointSolution");
+        if (cache.enabled())
+            cache << H << res << mixed_precision;
+        return cache.fetch<Matrix>([&]() { return Details::linsolve(H,res,mixed_precision); });
     }
 #endif
 
+    //  Solutions HeadMat^{-1}SourceMat of the head model for a set of sources. They do not depend on the sensors,
+    //  so when the sensors are re-registered (the head model being unchanged), the new gains only cost the product
+    //  of the new sensor matrices with these solutions. They are also kept in the matrix cache (when enabled).
+
+    class SourceSolutions: public Matrix {
+    public:
+        using Matrix::operator=;
+        SourceSolutions(const Matrix& X): Matrix(X) { }
+        SourceSolutions(const SymMatrix& HeadMat,const Matrix& SourceMat,const bool mixed_precision=false) {
+            MatrixCache cache("SourceSolutions");
+            if (cache.enabled())
+                cache << HeadMat << SourceMat << mixed_precision;
+            *this = cache.fetch<Matrix>([&]() {
+                Matrix X(SourceMat,DEEP_COPY);
+                Details::solve(HeadMat,X,mixed_precision);
+                return X;
+            });
+        }
+        ~SourceSolutions() { }
+    };
+
     class GainMEG: public Matrix {
     public:
         using Matrix::operator=;
@@ -91,6 +150,9 @@ namespace OpenMEEG {
         GainMEG(const SymMatrix& HeadMatInv,const Matrix& SourceMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
             Matrix(Source2MEGMat+(Head2MEGMat*HeadMatInv)*SourceMat)
         { }
+        GainMEG(const SourceSolutions& X,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
+            Matrix(Source2MEGMat+Head2MEGMat*X)
+        { }
         ~GainMEG () {};
     };
 
@@ -101,20 +163,43 @@ namespace OpenMEEG {
         GainEEG (const SymMatrix& HeadMatInv,const Matrix& SourceMat,const SparseMatrix& Head2EEGMat):
             Matrix((Head2EEGMat*HeadMatInv)*SourceMat)
         { }
+        GainEEG(const SourceSolutions& X,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat*X) { }
         ~GainEEG () {};
     };
 
+    namespace Details {
+
+        //  The adjoint gains are computed by blocks of dipoles: the DipSourceMat columns of a block are assembled
+        //  (in parallel over the dipoles) and the adjoint solutions are applied to them with one matrix product.
+        //  The memory used for the source matrix is thus bounded by the block size instead of the number of dipoles.
+
+        constexpr size_t dipole_block_size = 256;
+
+        template <typename Function>
+        void dipole_blocks(const Geometry& geo,const Matrix& dipoles,const Function& apply) {
+            const unsigned gauss_order = 3;
+            const size_t   n_dipoles   = dipoles.nlin();
+            ProgressBar pb(n_dipoles);
+            for (size_t first=0; first<n_dipoles; first+=dipole_block_size) {
+                const size_t size = std::min(dipole_block_size,n_dipoles-first);
+                const DipSourceMat DSM(geo,dipoles.submat(first,size,0,dipoles.ncol()),pb,gauss_order,true,"");
+                apply(first,DSM);
+            }
+        }
+    }
+
     class GainEEGadjoint: public Matrix {
     public:
 
         using Matrix::operator=;
 
-        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat.nlin(),dipoles.nlin()) {
-            const Matrix& Hinv = linsolve(HeadMat,Head2EEGMat);
-            const int gauss_order = 3;
-            ProgressBar pb(ncol());
-            for (unsigned i=0; i<ncol(); ++i,++pb)
-                setcol(i,Hinv*DipSourceMat(geo,dipoles.submat(i,1,0,dipoles.ncol()),gauss_order,true,"").getcol(0)); // TODO ugly
+        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,const bool mixed_precision=false):
+            Matrix(Head2EEGMat.nlin(),dipoles.nlin())
+        {
+            const Matrix& Hinv = linsolve(HeadMat,Head2EEGMat,mixed_precision);
+            Details::dipole_blocks(geo,dipoles,[&](const size_t first,const Matrix& DSM) {
+                insertmat(0,first,Hinv*DSM);
+            });
         }
         ~GainEEGadjoint () {};
     };
@@ -124,38 +209,40 @@ namespace OpenMEEG {
 
         using Matrix::operator=;
 
-        GainMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
+        GainMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat,
+                       const bool mixed_precision=false):
             Matrix(Head2MEGMat.nlin(),dipoles.nlin()) 
         {
-            const Matrix& Hinv = linsolve(HeadMat,Head2MEGMat);
-            const int gauss_order = 3;
-            ProgressBar pb(ncol());
-            for (unsigned i=0; i<ncol(); ++i,++pb)
-                setcol(i,Hinv*DipSourceMat(geo,dipoles.submat(i,1,0,dipoles.ncol()),gauss_order,true,"").getcol(0)+Source2MEGMat.getcol(i)); // TODO ugly
+            const Matrix& Hinv = linsolve(HeadMat,Head2MEGMat,mixed_precision);
+            Details::dipole_blocks(geo,dipoles,[&](const size_t first,const Matrix& DSM) {
+                insertmat(0,first,Hinv*DSM+Source2MEGMat.submat(0,nlin(),first,DSM.ncol()));
+            });
         }
         ~GainMEGadjoint () {};
     };
 
     class GainEEGMEGadjoint {
     public:
-        GainEEGMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
+        GainEEGMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat,
+                          const bool mixed_precision=false):
             EEGleadfield(Head2EEGMat.nlin(),dipoles.nlin()),MEGleadfield(Head2MEGMat.nlin(),dipoles.nlin())
         {
-            Matrix RHS(Head2EEGMat.nlin()+Head2MEGMat.nlin(),HeadMat.nlin());
-            for (unsigned i=0; i<Head2EEGMat.nlin(); ++i) {
+            const size_t n_eeg = Head2EEGMat.nlin();
+            const size_t n_meg = Head2MEGMat.nlin();
+
+            Matrix RHS(n_eeg+n_meg,HeadMat.nlin());
+            for (unsigned i=0; i<n_eeg; ++i)
                 RHS.setlin(i,Head2EEGMat.getlin(i));
-                RHS.setlin(i+Head2EEGMat.nlin(),Head2MEGMat.getlin(i));
-            }
+            for (unsigned i=0; i<n_meg; ++i)
+                RHS.setlin(i+n_eeg,Head2MEGMat.getlin(i));
 
-            const Matrix& Hinv = linsolve(HeadMat,RHS);
+            const Matrix& Hinv = linsolve(HeadMat,RHS,mixed_precision);
 
-            const unsigned gauss_order = 3;
-            ProgressBar pb(dipoles.nlin());
-            for ( unsigned i=0; i<dipoles.nlin(); ++i,++pb) {
-                Vector dsm = DipSourceMat(geo,dipoles.submat(i, 1, 0, dipoles.ncol()), gauss_order, true, "").getcol(0); // TODO ugly
-                EEGleadfield.setcol(i,Hinv.submat(0,Head2EEGMat.nlin(),0,HeadMat.nlin())*dsm);
-                MEGleadfield.setcol(i,Hinv.submat(Head2EEGMat.nlin(), Head2MEGMat.nlin(),0,HeadMat.nlin())*dsm+Source2MEGMat.getcol(i));
-            }
+            Details::dipole_blocks(geo,dipoles,[&](const size_t first,const Matrix& DSM) {
+                const Matrix& leadfields = Hinv*DSM;
+                EEGleadfield.insertmat(0,first,leadfields.submat(0,n_eeg,0,DSM.ncol()));
+                MEGleadfield.insertmat(0,first,leadfields.submat(n_eeg,n_meg,0,DSM.ncol())+Source2MEGMat.submat(0,n_meg,first,DSM.ncol()));
+            });
         }
         
         void saveEEG( const std::string filename ) const { EEGleadfield.save(filename); }
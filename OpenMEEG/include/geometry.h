@@ -209,19 +209,38 @@ namespace OpenMEEG {
 
         //  Calling this method read induces failures due do wrong conversions when read is passed with one or two arguments...
 
+        //  When a cache directory is set, finalized geometries are also stored there in a binary form,
+        //  which is reused as long as the contents of all the input files (geometry, conductivities and
+        //  meshes) are unchanged.
+
         void load(const std::string& filename,const bool OLD_ORDERING=false) {
             clear();
+            input_files.clear();
+            const std::string& cache = cache_file(filename,"",OLD_ORDERING);
+            if (read_cache(cache))
+                return;
             read_geometry_file(filename);
             finalize(OLD_ORDERING);
+            write_cache(cache);
         }
 
         void load(const std::string& geomFileName,const std::string& condFileName,const bool OLD_ORDERING=false) {
             clear();
+            input_files.clear();
+            const std::string& cache = cache_file(geomFileName,condFileName,OLD_ORDERING);
+            if (read_cache(cache))
+                return;
             read_geometry_file(geomFileName);
             read_conductivity_file(condFileName);
             finalize(OLD_ORDERING);
+            write_cache(cache);
         }
 
+        /// \brief Directory holding cached geometries (caching is disabled if empty).
+        /// Defaults to the value of the OPENMEEG_CACHE_DIR environment variable.
+
+        static std::string cache_directory;
+
         void import(const MeshList& meshes);
 
         void save(const std::string& filename) const;
@@ -261,6 +280,8 @@ namespace OpenMEEG {
 
     private:
 
+        friend class GeometryIO;
+
         void clear() {
             geom_vertices.clear();
             geom_meshes.clear();
@@ -268,11 +289,22 @@ namespace OpenMEEG {
             conductivities = nested = false;
             outer_domain = 0;
             num_params = 0;
+            invalid_vertices_.clear();
+            nb_current_barrier_triangles_ = 0;
+            independant_parts.clear();
+            meshpairs.clear();
         }
 
         void read_geometry_file(const std::string& filename);
         void read_conductivity_file(const std::string& filename);
 
+        /// Binary cache of finalized geometries (see geometry_cache.cpp).
+
+        static std::string cache_file(const std::string& geomFileName,const std::string& condFileName,const bool OLD_ORDERING);
+
+        bool read_cache(const std::string& filename);
+        void write_cache(const std::string& filename) const;
+
         void make_mesh_pairs();
 
         /// Members
@@ -318,5 +350,7 @@ namespace OpenMEEG {
 
         MeshParts independant_parts;  ///< \brief Mesh names that belong to different isolated groups.
         MeshPairs meshpairs;
+
+        std::vector<std::string> input_files; ///< \brief Files read to build the geometry (used to validate cached geometries).
     };
 }
@@ -0,0 +1,113 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <linop.h>
+#include <vector.h>
+#include <matrix.h>
+#include <geometry.h>
+
+#include <OpenMEEG_Export.h>
+
+namespace OpenMEEG {
+
+    /// \brief Matrix-free version of HeadMat.
+    /// The S, D, D* and N blocks are applied to vectors on the fly using the same kernels as HeadMat,
+    /// so that memory stays linear in the number of unknowns. Interactions between triangles that are
+    /// closer than near_field times the sum of their sizes (square root of their areas) are computed
+    /// once at construction and cached (near_field=0 disables caching).
+
+    class OPENMEEG_EXPORT HeadMatOperator: public LinOp {
+    public:
+
+        HeadMatOperator(const Geometry& geo,const unsigned gauss_order=3,const double near_field=0.0);
+        virtual ~HeadMatOperator() { }
+
+        size_t size() const { return nlin()*ncol(); }
+        void   info() const;
+
+        Vector operator*(const Vector& x) const; ///< \return HeadMat*x
+        Matrix operator*(const Matrix& X) const; ///< \return HeadMat*X (all the columns of X at once).
+
+        const Vector& diagonal() const { return diag; } ///< \return the diagonal of HeadMat (e.g. for Jacobi preconditioning).
+
+        size_t nb_cached_interactions() const;
+
+    private:
+
+        struct Interaction {
+            unsigned index; // Index of the second triangle in its mesh.
+            double   S;
+            Vect3    D;     // Contribution of the second triangle on the first one.
+            Vect3    Dstar; // Contribution of the first triangle on the second one.
+        };
+
+        typedef std::vector<std::vector<Interaction>> NearField;
+
+        struct Block {
+            const Mesh* mesh1;
+            const Mesh* mesh2;
+            double      Scoeff;
+            double      Dcoeff;
+            double      Ncoeff;
+            bool        S;
+            bool        D;
+            bool        Dstar;
+            NearField   near;
+        };
+
+        struct Deflation {
+            const Mesh* mesh;
+            double      coeff;
+        };
+
+        void apply(const double* x,double* y,const unsigned ncols) const;
+        void apply(const Block& block,const double* x,double* y,const unsigned ncols) const;
+        void cache_near_field(Block& block,const double near_field);
+        void compute_diagonal(const Geometry& geo);
+
+        const unsigned         gauss_order;
+        std::vector<Block>     blocks;
+        std::vector<Deflation> deflations;
+        Vector                 diag;
+    };
+}
@@ -0,0 +1,139 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <OpenMEEG_Export.h>
+
+namespace OpenMEEG {
+
+    /// \brief Lightweight run time instrumentation: named timers (with call counts and peak memory),
+    /// event counters and per thread busy time. Everything is a no-op until start() is called, so that
+    /// the instrumentation can stay in the computational kernels. The results are reported in JSON.
+
+    class OPENMEEG_EXPORT Profiler {
+    public:
+
+        enum Counter { KernelEvaluations, AdaptiveRefinements, NbCounters };
+
+        typedef std::chrono::steady_clock Clock;
+
+        static bool enabled() { return active; }
+
+        static void start();
+
+        static void count(const Counter counter,const uint64_t n=1) {
+            if (active)
+                increment(counter,n);
+        }
+
+        static void add_time(const std::string& timer,const double seconds);
+        static void add_busy_time(const double seconds);
+
+        /// Peak resident set size of the process in kilobytes (0 if unavailable).
+
+        static uint64_t peak_rss();
+
+        static void report(std::ostream& os);
+
+        /// Write the report in filename, returns false if the file cannot be written.
+
+        static bool save(const std::string& filename);
+
+        /// Remove the "--profile file" arguments from the command line and start the profiler if they are found.
+        /// Returns the name of the report file (empty if profiling was not requested). The command line is
+        /// recorded in the report.
+
+        static std::string option(int& argc,char** argv);
+
+    private:
+
+        static void increment(const Counter counter,const uint64_t n);
+
+        static bool active;
+    };
+
+    /// \brief Measure the time spent in a scope (an operator, a solve, ...).
+
+    class ScopedTimer {
+    public:
+
+        ScopedTimer(const char* timer): name(timer),active(Profiler::enabled()) {
+            if (active)
+                start = Profiler::Clock::now();
+        }
+
+        ~ScopedTimer() {
+            if (active)
+                Profiler::add_time(name,std::chrono::duration<double>(Profiler::Clock::now()-start).count());
+        }
+
+    private:
+
+        const char*                 name;
+        const bool                  active;
+        Profiler::Clock::time_point start;
+    };
+
+    /// \brief Measure the time a thread spends working in a parallel loop (to be put in the loop body).
+
+    class ThreadTimer {
+    public:
+
+        ThreadTimer(): active(Profiler::enabled()) {
+            if (active)
+                start = Profiler::Clock::now();
+        }
+
+        ~ThreadTimer() {
+            if (active)
+                Profiler::add_busy_time(std::chrono::duration<double>(Profiler::Clock::now()-start).count());
+        }
+
+    private:
+
+        const bool                  active;
+        Profiler::Clock::time_point start;
+    };
+}
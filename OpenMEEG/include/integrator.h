@@ -45,6 +45,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <vertex.h>
 #include <triangle.h>
 #include <mesh.h>
+#include <instrumentation.h>
 
 namespace OpenMEEG {
 
@@ -192,6 +193,7 @@ namespace OpenMEEG {
     protected:
 
         inline T triangle_integration(const I& fc,const Vect3 points[3]) {
+            Profiler::count(Profiler::KernelEvaluations,nbPts[order]);
             T result = 0;
             for (unsigned i=0;i<nbPts[order];++i) {
                 Vect3 v(0.0,0.0,0.0);
@@ -247,6 +249,7 @@ namespace OpenMEEG {
             if (norm(I0-sum)>tolerance*norm(I0)) {
                 n = n+1;
                 if (n<10) {
+                    Profiler::count(Profiler::AdaptiveRefinements);
                     I1 = adaptive_integration(fc,points1,I1,n);
                     I2 = adaptive_integration(fc,points2,I2,n);
                     I3 = adaptive_integration(fc,points3,I3,n);
@@ -0,0 +1,150 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <OpenMEEG_Export.h>
+
+#include <vector.h>
+#include <matrix.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+#include <geometry.h>
+#include <sensors.h>
+#include <content_hash.h>
+
+namespace OpenMEEG {
+
+    /// \brief On-disk cache of computed matrices.
+    /// An entry is addressed by a hash of everything the matrix depends upon (the kind of matrix, the code
+    /// version, and whatever is streamed into the cache: geometry contents and conductivities, sensors,
+    /// dipoles, integration order, ...). When the cache grows beyond max_size, the least recently used
+    /// entries are removed. Caching is disabled when directory is empty.
+
+    class OPENMEEG_EXPORT MatrixCache {
+    public:
+
+        MatrixCache(const std::string& kind);
+
+        MatrixCache& operator<<(const Geometry& geo) { return add(geo,true); }
+        MatrixCache& operator<<(const Sensors& sensors);
+        MatrixCache& operator<<(const Vector& V);
+        MatrixCache& operator<<(const Matrix& M);
+        MatrixCache& operator<<(const SymMatrix& M);
+        MatrixCache& operator<<(const SparseMatrix& M);
+        MatrixCache& operator<<(const std::string& str) { key.add(str); return *this; }
+
+        template <typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value,MatrixCache&>::type
+        operator<<(const T& value) { key.add(value); return *this; }
+
+        /// Geometry without the values of the conductivities (only the non-conductive domains are identified),
+        /// for data depending only on the meshes and on the domain structure.
+
+        MatrixCache& add_shape(const Geometry& geo) { return add(geo,false); }
+
+        bool enabled() const { return !directory.empty(); }
+
+        /// Identity of the cached matrix (also usable to validate other files derived from the same inputs).
+
+        const ContentHash& hash() const { return key; }
+
+        /// Returns the cached matrix or computes it with build() (and stores it in the cache).
+
+        template <typename MATRIX,typename BUILDER>
+        MATRIX fetch(const BUILDER& build) const {
+            MATRIX M;
+            if (load(M))
+                return M;
+            M = build();
+            store(M);
+            return M;
+        }
+
+        template <typename MATRIX>
+        bool load(MATRIX& M) const {
+            if (!lookup())
+                return false;
+            try {
+                M.load(filename());
+            } catch (...) {
+                return false;
+            }
+            std::cout << "Using cached " << kind << " (" << filename() << ")." << std::endl;
+            return true;
+        }
+
+        template <typename MATRIX>
+        void store(const MATRIX& M) const {
+            if (!enabled())
+                return;
+            const std::string& tmpname = temporary();
+            try {
+                M.save(tmpname);
+            } catch (...) {
+                discard(tmpname);
+                return;
+            }
+            commit(tmpname);
+        }
+
+        static std::string   directory; ///< Cache directory (defaults to $OPENMEEG_CACHE_DIR).
+        static std::uintmax_t max_size; ///< Cache size limit in bytes (defaults to $OPENMEEG_CACHE_SIZE megabytes, 0 means unlimited).
+
+    private:
+
+        MatrixCache& add(const Geometry& geo,const bool conductivities);
+
+        std::string filename() const;
+        std::string temporary() const;
+
+        bool lookup() const;
+        void commit(const std::string& tmpname) const;
+
+        static void discard(const std::string& name);
+        static void evict(const std::string& keep);
+
+        const std::string kind;
+        ContentHash       key;
+    };
+}
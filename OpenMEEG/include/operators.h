@@ -53,14 +53,17 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <analytics.h>
 
 #include <progressbar.h>
+#include <instrumentation.h>
 
 namespace OpenMEEG {
 
     // TODO: Use overloading and remove the internal suffix.
+    // The internal operators compute the D and/or S (if the coefficient is not zero) contributions of a mesh to the
+    // potential at the points. Triangles seen with an angle smaller than theta use a Gauss rule (far field).
 
-    void operatorSinternal(const Mesh&,Matrix&,const Vertices&,const double&);
-    void operatorDinternal(const Mesh&,Matrix&,const Vertices&,const double&);
-    void operatorFerguson(const Vect3&,const Mesh&,Matrix&,const unsigned&,const double&);
+    void operatorSinternal(const Mesh&,Matrix&,const Vertices&,const double&,const double theta=0.0);
+    void operatorDinternal(const Mesh&,Matrix&,const Vertices&,const double&,const double theta=0.0);
+    void operatorInternal(const Mesh&,Matrix&,const Vertices&,const double coeffD,const double coeffS,const double theta=0.0);
     void operatorDipolePotDer(const Vect3&,const Vect3&,const Mesh&,Vector&,const double&,const unsigned,const bool);
     void operatorDipolePot(const Vect3&,const Vect3&,const Mesh&,Vector&,const double&,const unsigned,const bool);
 
@@ -69,7 +72,7 @@ namespace OpenMEEG {
 
         template <template <typename,typename> class Integrator>
         void operatorDipolePot(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order) {
-            static analyticDipPot anaDP;
+            analyticDipPot anaDP;
 
             anaDP.init(q,r0);
             Integrator<double,analyticDipPot> gauss(0.001);
@@ -85,18 +88,16 @@ namespace OpenMEEG {
             for (int i=0;i<m.triangles().size();++i) {
                 const Triangle& triangle = *(m.triangles().begin()+i);
             #endif
+                const ThreadTimer busy;
                 const double d = gauss->integrate(anaDP,triangle);
-                #pragma omp critical
-                rhs(triangle.index()) += d*coeff;
+                rhs(triangle.index()) += d*coeff; // Each triangle has its own entry: no synchronization is needed.
             }
         }
 
         // T can be a Matrix or SymMatrix
 
-        template <typename T>
-        inline void operatorD(const Triangle& T1,const Triangle& T2,T& mat,const double& coeff,const unsigned gauss_order) {
-            //this version of operatorD add in the Matrix the contribution of T2 on T1
-            // for all the P1 functions it gets involved
+        inline Vect3 operatorD(const Triangle& T1,const Triangle& T2,const unsigned gauss_order) {
+            // Contribution of T2 on T1 for the 3 P1 functions of T2.
             // consider varying order of quadrature with the distance between T1 and T2
             analyticD3 analyD(T2);
 
@@ -106,7 +107,14 @@ namespace OpenMEEG {
         #else
             STATIC_OMP Integrator<Vect3, analyticD3> gauss(gauss_order);
         #endif
-            const Vect3 total = gauss.integrate(analyD,T1);
+            return gauss.integrate(analyD,T1);
+        }
+
+        template <typename T>
+        inline void operatorD(const Triangle& T1,const Triangle& T2,T& mat,const double& coeff,const unsigned gauss_order) {
+            //this version of operatorD add in the Matrix the contribution of T2 on T1
+            // for all the P1 functions it gets involved
+            const Vect3 total = operatorD(T1,T2,gauss_order);
 
             for (unsigned i=0; i<3; ++i)
                 mat(T1.index(),T2.vertex(i).index()) += total(i)*coeff;
@@ -206,6 +214,7 @@ namespace OpenMEEG {
             for (int i1=0; i1 < m1_triangles.size(); ++i1) {
                 const Triangle& triangle1 = *(m1_triangles.begin()+i1);
             #endif
+                const ThreadTimer busy;
                 for (const auto& triangle2 : m2.triangles())
                     Details::operatorD(triangle1,triangle2,mat,coeff,gauss_order);
                 ++pb;
@@ -222,6 +231,7 @@ namespace OpenMEEG {
         //    the gauss order parameter (for adaptive integration)
 
         std::cout << "OPERATOR N ... (arg : mesh " << m1.name() << " , mesh " << m2.name() << " )" << std::endl;
+        const ScopedTimer timer("operator N");
 
         if (&m1==&m2) {
             auto NUpdate = [&](const Mesh& m,const auto& M) {
@@ -234,6 +244,7 @@ namespace OpenMEEG {
                     for (int i2=0;i2<=vit1-m1.vertices().begin();++i2) {
                         const auto vit2 = m1.vertices().begin()+i2;
                     #endif
+                        const ThreadTimer busy;
                         mat((*vit1)->index(),(*vit2)->index()) += Details::operatorN(**vit1,**vit2,m,m,M)*coeff;
                     }
                     ++pb;
@@ -255,6 +266,7 @@ namespace OpenMEEG {
                     for (int i2=tit1-m1.triangles().begin();i2<m1.triangles().size();++i2) {
                         const Triangles::const_iterator tit2 = m1.triangles().begin()+i2;
                     #endif
+                        const ThreadTimer busy;
                         const unsigned ind2 = tit2->index()-m2.triangles().front().index();
                         matS(ind1,ind2) = Details::operatorS(analyS,*tit2,gauss_order)/(tit1->area()*tit2->area());
                     }
@@ -279,6 +291,7 @@ namespace OpenMEEG {
                     for (int i2=0;i2<v2.size();++i2) {
                         const Vertex* vertex2 = *(v2.begin()+i2);
                     #endif
+                        const ThreadTimer busy;
                         mat(vertex1->index(),vertex2->index()) += Details::operatorN(*vertex1,*vertex2,m1,m2,M)*coeff;
                     }
                     ++pb;
@@ -304,6 +317,7 @@ namespace OpenMEEG {
                     for (int i2=0;i2<m2_triangles.size();++i2) {
                         const Triangle& triangle2 = *(m2_triangles.begin()+i2);
                     #endif
+                        const ThreadTimer busy;
                         const unsigned ind2 = triangle2.index()-m2_triangles.front().index();
                         matS(ind1,ind2) = Details::operatorS(analyS,triangle2,gauss_order)/(triangle1.area()*triangle2.area());
                     }
@@ -326,6 +340,7 @@ namespace OpenMEEG {
         //    the gauss order parameter (for adaptive integration)
 
         std::cout << "OPERATOR S ... (arg : mesh " << m1.name() << " , mesh " << m2.name() << " )" << std::endl;
+        const ScopedTimer timer("operator S");
 
         // The operator S is given by Sij=\Int G*PSI(I, i)*Psi(J, j) with
         // PSI(A, a) is a P0 test function on layer A and triangle a
@@ -340,6 +355,7 @@ namespace OpenMEEG {
                 for (int i2=tit1-m1.triangles().begin();i2<m1.triangles().size();++i2) {
                     const Triangles::const_iterator tit2 = m1.triangles().begin()+i2;
                 #endif
+                    const ThreadTimer busy;
                     mat(tit1->index(),tit2->index()) = Details::operatorS(analyS,*tit2,gauss_order)*coeff;
                 }
             }
@@ -362,6 +378,7 @@ namespace OpenMEEG {
                 for (int i2=0;i2<m2_triangles.size();++i2) {
                     const Triangle& triangle2 = *(m2_triangles.begin()+i2);
                 #endif
+                    const ThreadTimer busy;
                     mat(triangle1.index(),triangle2.index()) = Details::operatorS(analyS,triangle2,gauss_order)*coeff;
                 }
                 ++pb;
@@ -378,6 +395,7 @@ namespace OpenMEEG {
         //    the gauss order parameter (for adaptive integration)
 
         std::cout << "OPERATOR D... (arg : mesh " << m1.name() << " , mesh " << m2.name() << " )" << std::endl;
+        const ScopedTimer timer("operator D");
         Details::operatorD(m1,m2,mat,coeff,gauss_order);
     }
 
@@ -390,6 +408,7 @@ namespace OpenMEEG {
         //    the gauss order parameter (for adaptive integration)
 
         std::cout << "OPERATOR D*... (arg : mesh " << m1.name() << " , mesh " << m2.name() << ')' << std::endl;
+        const ScopedTimer timer("operator D*");
         Details::operatorD(m2,m1,mat,coeff,gauss_order);
     }
 
@@ -39,6 +39,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <iostream>
 
@@ -49,21 +50,26 @@ namespace OpenMEEG {
 
         ProgressBar(const unsigned n,const unsigned sz=20): max_iter(n),bar_size(sz) { }
 
+        //  May be called from the threads of a parallel loop: only the thread which moves the bar draws it.
+
         void operator++() {
-            const unsigned p = std::min(static_cast<unsigned>(floor(static_cast<double>((bar_size+1)*iter++)/max_iter)),bar_size);
-            if (p!=pprev && iter>1) {
-                std::cout << std::string(bar_size+2,'\b') << '[' << std::string(p,'*') << std::string(bar_size-p,'.') << ']';
-                pprev = p;
+            const unsigned it = iter++;
+            const unsigned p  = std::min(static_cast<unsigned>(floor(static_cast<double>((bar_size+1)*it)/max_iter)),bar_size);
+            if (it>0 && pprev.exchange(p)!=p) {
+                #pragma omp critical(progressbar)
+                {
+                    std::cout << std::string(bar_size+2,'\b') << '[' << std::string(p,'*') << std::string(bar_size-p,'.') << ']';
+                    std::cout.flush();
+                }
             }
-            if (iter>=max_iter)
+            if (it+1==max_iter)
                 std::cout << std::endl;
-            std::cout.flush();
         }
-        
+
     private:
-        
-        unsigned iter = 0;
-        unsigned pprev = -1;
+
+        std::atomic<unsigned> iter{0};
+        std::atomic<unsigned> pprev{static_cast<unsigned>(-1)};
         const unsigned max_iter;
         const unsigned bar_size;
     };
@@ -0,0 +1,94 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <OpenMEEG_Export.h>
+
+#include <vect3.h>
+#include <matrix.h>
+#include <geometry.h>
+
+namespace OpenMEEG {
+
+    /// \brief Rectilinear grid of points, as the VTK RECTILINEAR_GRID datasets (see apps/tools/scilab/MakeRectiGridPts.sci
+    /// and savevtkrectigrid.sci). The grid points are numbered with x varying fastest, then y, then z.
+
+    class OPENMEEG_EXPORT RectilinearGrid {
+    public:
+
+        typedef std::vector<double> Coordinates;
+
+        RectilinearGrid() { }
+        RectilinearGrid(const Coordinates& x,const Coordinates& y,const Coordinates& z): coords{ x, y, z } { check(); }
+        RectilinearGrid(const std::string& filename) { load(filename); }
+
+        /// Load/save a legacy ASCII VTK file containing a RECTILINEAR_GRID dataset (point data are ignored).
+
+        void load(const std::string& filename);
+        void save(const std::string& filename) const;
+
+        const Coordinates& coordinates(const unsigned i) const { return coords[i]; }
+
+        size_t nb_points() const { return coords[0].size()*coords[1].size()*coords[2].size(); }
+
+        Vect3 point(const size_t i) const {
+            const size_t nx = coords[0].size();
+            const size_t ny = coords[1].size();
+            return Vect3(coords[0][i%nx],coords[1][(i/nx)%ny],coords[2][i/(nx*ny)]);
+        }
+
+        Matrix points() const; ///< One line per grid point.
+
+        /// Domain of each grid point. Instead of computing the solid angles of all the interfaces for each point,
+        /// rays are cast along the x lines of the grid: the intersections of each line with the interfaces are
+        /// computed once and the points of the line are classified by the parity of the crossings beyond them.
+
+        std::vector<const Domain*> domains(const Geometry& geo) const;
+
+    private:
+
+        void check() const; ///< Coordinates must be strictly increasing.
+
+        Coordinates coords[3];
+    };
+}
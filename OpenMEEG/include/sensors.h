@@ -141,6 +141,8 @@ namespace OpenMEEG {
         void info() const; /*!< \brief get info about sensors. */
 
     private:
+        friend class SensorCoils;
+
         size_t m_nb;                        /*!< Number of sensors. */
         Strings m_names;                    /*!< List of sensors names. */
         Matrix m_positions;                 /*!< Matrix of sensors positions. ex: positions(i,j) with  j in {0,1,2} for sensor i */
@@ -153,6 +155,43 @@ namespace OpenMEEG {
         void findInjectionTriangles();      /*!< Get the triangles under each EIT sensors */
     };
 
+    /*!
+     *  Integration points of MEG sensors grouped per sensor (coil).
+     *  The points of sensor s are numbered from begin(s) to end(s)-1 and their positions and orientations are stored
+     *  contiguously. Orientations are normalized and multiplied by the integration weight of the point, so that the
+     *  assemblers accumulate the weighted contribution of each point directly in the line of its coil, instead of
+     *  computing one line per integration point and applying getWeightsMatrix() afterwards.
+     */
+
+    class OPENMEEG_EXPORT SensorCoils {
+    public:
+
+        SensorCoils(const Sensors& sensors);
+
+        /// Coils of the selected sensors only: coil k gathers the integration points of sensor selection[k].
+
+        SensorCoils(const Sensors& sensors,const std::vector<size_t>& selection);
+
+        size_t nb_sensors() const { return offsets.size()-1; } /*!< Number of coils (lines of the assembled matrices). */
+        size_t nb_points()  const { return coil.size();      } /*!< Total number of integration points. */
+
+        size_t begin(const size_t s) const { return offsets[s];   } /*!< First point of coil s. */
+        size_t end(const size_t s)   const { return offsets[s+1]; } /*!< One past the last point of coil s. */
+
+        size_t       sensor(const size_t i)    const { return coil[i];       } /*!< Coil of point i. */
+        size_t       point(const size_t i)     const { return points[i];     } /*!< Index of point i in the Sensors. */
+        const Vect3& position(const size_t i)  const { return positions[i];  } /*!< Position of point i. */
+        const Vect3& direction(const size_t i) const { return directions[i]; } /*!< Weighted unit orientation of point i. */
+
+    private:
+
+        std::vector<size_t> offsets;
+        std::vector<size_t> coil;
+        std::vector<size_t> points;
+        std::vector<Vect3>  positions;
+        std::vector<Vect3>  directions;
+    };
+
     inline Vector Sensors::getPosition(size_t idx) const {
         return m_positions.getlin(idx);
     }
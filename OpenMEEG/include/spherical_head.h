@@ -0,0 +1,110 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <OpenMEEG_Export.h>
+
+#include <vertex.h>
+#include <triangle.h>
+
+namespace OpenMEEG {
+
+    /// \brief Build a unit sphere by refining subdivisions times an icosahedron (each triangle is split in 4).
+    /// The result has 10*4^subdivisions+2 vertices and 20*4^subdivisions triangles, oriented outwards.
+
+    OPENMEEG_EXPORT void icosphere(const unsigned subdivisions,Vertices& vertices,std::vector<TriangleIndices>& triangles);
+
+    /// \brief Synthetic head made of concentric spheres sharing the same triangulation, with the input files
+    /// needed by the om_* tools (meshes, geometry, conductivities, dipoles, EEG electrodes, MEG squids).
+    /// Since the geometry is spherical, the results can be compared to the analytic solutions (see
+    /// apps/tools/matlab/om_spher_pot_iso.m and om_spher_mag_iso.m).
+
+    class OPENMEEG_EXPORT SphericalHead {
+    public:
+
+        struct Layer {
+            std::string name;
+            double      radius;
+            double      conductivity;
+        };
+
+        typedef std::vector<Layer> Layers;
+
+        /// Layers are ordered from the innermost to the outermost one.
+
+        SphericalHead(const unsigned subdivisions,const Layers& layers);
+
+        /// The usual brain, (csf,) skull, scalp models (with radii 0.87,0.92,1 for the three layer model),
+        /// or n evenly spaced layers of unit conductivity otherwise.
+
+        static Layers default_layers(const unsigned n);
+
+        const Layers& layers() const { return head_layers; }
+
+        unsigned nb_vertices()  const { return vertices.size();  }
+        unsigned nb_triangles() const { return triangles.size(); }
+
+        /// Size of the head matrix (potentials on all interfaces and normal currents on all but the outermost).
+
+        unsigned nb_unknowns() const { return head_layers.size()*nb_vertices()+(head_layers.size()-1)*nb_triangles(); }
+
+        /// Write the files basename.geom, basename.cond, basename.dip, basename.patches, basename.squids and
+        /// one basename-<layer>.tri per layer. Dipoles are spread inside the innermost sphere, electrodes on the
+        /// upper half of the outermost sphere and radial magnetometers on the upper half of a sphere 15% larger.
+
+        void save(const std::string& basename,const unsigned nb_dipoles,const unsigned nb_electrodes,const unsigned nb_squids) const;
+
+    private:
+
+        void save_meshes(const std::string& basename) const;
+        void save_geometry(const std::string& basename) const;
+        void save_conductivities(const std::string& basename) const;
+        void save_dipoles(const std::string& filename,const unsigned n) const;
+        void save_electrodes(const std::string& filename,const unsigned n) const;
+        void save_squids(const std::string& filename,const unsigned n) const;
+
+        Layers                       head_layers;
+        Vertices                     vertices;
+        std::vector<TriangleIndices> triangles;
+    };
+}
@@ -37,28 +37,323 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
 #include <operators.h>
-#include <progressbar.h>
+#include <analytics.h>
+#include <instrumentation.h>
 #include <constants.h>
+#include <sensors.h>
 
 namespace OpenMEEG {
 
-    // geom = geometry
-    // mat  = storage for Ferguson Matrix
-    // pts  = where the magnetic field is to be computed
+    namespace {
+
+        //  Per triangle data of the Ferguson kernel, computed once and shared by all sensors: the single layer
+        //  integral and, for each vertex V of the triangle, the (scaled) vector AB where A and B are the
+        //  opposite vertices (see Details::operatorFerguson). As in this function, the normal used by analyticS
+        //  is computed from the vertices (triangle normals may not be set or oriented consistently).
+
+        struct FergusonTriangle {
+
+            FergusonTriangle(const Triangle& T,const double coeff): S(T.vertex(0),T.vertex(1),T.vertex(2)) {
+                for (unsigned k=0; k<3; ++k) {
+                    const Vertex& V    = T.vertex(k);
+                    const Edge&   edge = T.edge(V);
+                    indices[k] = V.index();
+                    AB[k]      = (edge.vertex(0)-edge.vertex(1))*(0.5*coeff/T.area());
+                }
+            }
+
+            analyticS S;
+            unsigned  indices[3];
+            unsigned  clusters[3];
+            Vect3     AB[3];
+        };
+
+        //  Far field of the contribution of a vertex V (the triangles of a mesh around V). analyticS::f is minus
+        //  the integral of 1/|x-y| over the triangle. This kernel is expanded to third order around V (the cluster
+        //  centre), with r=x-V, u=y-V:
+        //      1/|r-u| = 1/|r| + <u,r>/|r|^3 + (3<u,r>^2-|u|^2|r|^2)/(2|r|^5) + (5<u,r>^3-3|u|^2|r|^2<u,r>)/(2|r|^7) + ...
+        //  so that the field only depends on the moments of order 0 to 3 of the triangles weighted by AB.
+        //  The relative error behaves as (radius/|r|)^3, the order 0 term vanishing for closed meshes.
+
+        struct FergusonCluster {
+
+            FergusonCluster(const Vertex& V): index(V.index()),center(V),radius(0.0) {
+                M0 = 0.0;
+                std::fill(&K1[0][0],&K1[0][0]+9,0.0);
+                std::fill(&K2[0][0],&K2[0][0]+18,0.0);
+                std::fill(&K3[0][0],&K3[0][0]+30,0.0);
+                std::fill(&Kn[0][0],&Kn[0][0]+9,0.0);
+                Kt = 0.0;
+            }
+
+            void add(const Triangle& T,const Vect3& AB) {
+                Vect3 v[3];
+                for (unsigned k=0; k<3; ++k) {
+                    v[k]   = T.vertex(k)-center;
+                    radius = std::max(radius,v[k].norm());
+                }
+
+                //  Moments of the triangle with respect to the centre, using the integrals of the products of
+                //  barycentric coordinates: int l_i = A/3, int l_i l_j = A/12 (1+[i=j]), int l_i l_j l_k = A/60 (1+[i=j]+[j=k]+[i=k]+2[i=j=k]).
+
+                const double area = T.area();
+                double U[3]       = { 0.0, 0.0, 0.0 };
+                double Q[3][3]    = { };
+                double C[3][3][3] = { };
+                for (unsigned i=0; i<3; ++i) {
+                    for (unsigned b=0; b<3; ++b)
+                        U[b] += area/3.0*v[i](b);
+                    for (unsigned j=0; j<3; ++j) {
+                        const double wij = area/12.0*(1+(i==j));
+                        for (unsigned b=0; b<3; ++b)
+                            for (unsigned c=0; c<3; ++c)
+                                Q[b][c] += wij*v[i](b)*v[j](c);
+                        for (unsigned k=0; k<3; ++k) {
+                            const double wijk = area/60.0*(1+(i==j)+(j==k)+(i==k)+2*(i==j && j==k));
+                            for (unsigned b=0; b<3; ++b)
+                                for (unsigned c=0; c<3; ++c)
+                                    for (unsigned e=0; e<3; ++e)
+                                        C[b][c][e] += wijk*v[i](b)*v[j](c)*v[k](e);
+                        }
+                    }
+                }
+
+                //  The moments are symmetric, only the distinct monomials of r are kept (with their multiplicities)
+                //  and the constants of the expansion are folded in the coefficients.
+
+                M0 += AB*area;
+                for (unsigned a=0; a<3; ++a) {
+                    for (unsigned b=0; b<3; ++b) {
+                        K1[a][b] += AB(a)*U[b];
+                        Kn[a][b] -= 1.5*AB(a)*(C[b][0][0]+C[b][1][1]+C[b][2][2]);
+                    }
+                    for (unsigned m=0; m<6; ++m)
+                        K2[a][m] += 1.5*Monomials2[m].multiplicity*AB(a)*Q[Monomials2[m].b][Monomials2[m].c];
+                    for (unsigned m=0; m<10; ++m)
+                        K3[a][m] += 2.5*Monomials3[m].multiplicity*AB(a)*C[Monomials3[m].b][Monomials3[m].c][Monomials3[m].e];
+                    Kt(a) -= 0.5*AB(a)*(Q[0][0]+Q[1][1]+Q[2][2]);
+                }
+            }
+
+            bool far(const Vect3& x,const double theta) const { return radius<theta*(x-center).norm(); }
+
+            double field(const Vect3& x,const Vect3& d) const {
+                const Vect3& r   = x-center;
+                const double r2  = r.norm2();
+                const double ir  = 1.0/std::sqrt(r2);
+                const double ir2 = ir*ir;
+
+                const double x0 = r(0), x1 = r(1), x2 = r(2);
+                const double r_2[6]  = { x0*x0, x0*x1, x0*x2, x1*x1, x1*x2, x2*x2 };
+                const double r_3[10] = { r_2[0]*x0, r_2[0]*x1, r_2[0]*x2, r_2[1]*x1, r_2[1]*x2,
+                                         r_2[2]*x2, r_2[3]*x1, r_2[3]*x2, r_2[4]*x2, r_2[5]*x2 };
+
+                double result = 0.0;
+                for (unsigned a=0; a<3; ++a) {
+                    double order1 = 0.0;
+                    double order2 = Kt(a)*r2;
+                    double order3 = 0.0;
+                    for (unsigned b=0; b<3; ++b) {
+                        order1 += K1[a][b]*r(b);
+                        order3 += Kn[a][b]*r(b);
+                    }
+                    order3 *= r2;
+
+                    for (unsigned m=0; m<6; ++m)
+                        order2 += K2[a][m]*r_2[m];
+                    for (unsigned m=0; m<10; ++m)
+                        order3 += K3[a][m]*r_3[m];
+                    result += d(a)*(M0(a)+ir2*(order1+ir2*(order2+ir2*order3)));
+                }
+                return -ir*result;
+            }
+
+            struct Monomial2 { unsigned b, c;    double multiplicity; };
+            struct Monomial3 { unsigned b, c, e; double multiplicity; };
+
+            static const Monomial2 Monomials2[6];
+            static const Monomial3 Monomials3[10];
+
+            unsigned index;
+            Vect3    center;
+            double   radius;
+            Vect3    M0;
+            double   K1[3][3];
+            double   K2[3][6];
+            double   K3[3][10];
+            double   Kn[3][3];
+            Vect3    Kt;
+        };
+
+        const FergusonCluster::Monomial2 FergusonCluster::Monomials2[6] = {
+            { 0, 0, 1 }, { 0, 1, 2 }, { 0, 2, 2 }, { 1, 1, 1 }, { 1, 2, 2 }, { 2, 2, 1 }
+        };
 
-    void assemble_ferguson(const Geometry& geom,Matrix& mat,const Matrix& pts) {
+        const FergusonCluster::Monomial3 FergusonCluster::Monomials3[10] = {
+            { 0, 0, 0, 1 }, { 0, 0, 1, 3 }, { 0, 0, 2, 3 }, { 0, 1, 1, 3 }, { 0, 1, 2, 6 },
+            { 0, 2, 2, 3 }, { 1, 1, 1, 1 }, { 1, 1, 2, 3 }, { 1, 2, 2, 3 }, { 2, 2, 2, 1 }
+        };
 
-        // Computation of blocks of Ferguson's Matrix
+        //  mat(c,v) += sum over points i of coil c and triangles T of v of S_T(x_i) <AB_T(v),w_i d_i> where d_i is the
+        //  unit orientation and w_i the integration weight of point i. This is the Ferguson field projected on the
+        //  sensor orientation, computed without building the 3 components and folded per coil on the fly.
+        //  Points are processed in blocks of whole coils, so that threads write disjoint rows of mat. When theta is
+        //  positive, the contribution of a vertex whose cluster is seen from the point with an angle (radius/distance)
+        //  smaller than theta is computed with the far field expansion.
 
-        const unsigned n = pts.nlin();
-        ProgressBar pb(geom.meshes().size()*n);
-        for (const auto& mesh : geom.meshes()) {
-            const double coeff = MagFactor*geom.conductivity_difference(mesh);
-            for (unsigned i=0,index=0; i<n; ++i,index+=3,++pb) {
-                const Vect3 p(pts(i,0),pts(i,1),pts(i,2));
-                operatorFerguson(p,mesh,mat,index,coeff);
+        class FergusonKernel {
+        public:
+
+            FergusonKernel(const double t): theta(t) { }
+
+            void add(const Mesh& mesh,const double coeff) {
+                if (coeff==0.0)
+                    return;
+                std::map<const Vertex*,unsigned> vertex_clusters;
+                for (const auto& T : mesh.triangles()) {
+                    triangles.push_back(FergusonTriangle(T,coeff));
+                    if (theta==0.0)
+                        continue;
+                    FergusonTriangle& triangle = triangles.back();
+                    for (unsigned k=0; k<3; ++k) {
+                        const Vertex* V = &T.vertex(k);
+                        const auto it = vertex_clusters.find(V);
+                        const unsigned ind = (it!=vertex_clusters.end()) ? it->second : vertex_clusters[V] = clusters.size();
+                        if (ind==clusters.size())
+                            clusters.push_back(FergusonCluster(*V));
+                        clusters[ind].add(T,triangle.AB[k]);
+                        triangle.clusters[k] = ind;
+                    }
+                }
+            }
+
+            void assemble(Matrix& mat,const SensorCoils& coils) const;
+
+        private:
+
+            const double                  theta;
+            std::vector<FergusonTriangle> triangles;
+            std::vector<FergusonCluster>  clusters;
+        };
+
+        void FergusonKernel::assemble(Matrix& mat,const SensorCoils& coils) const {
+
+            const size_t n = coils.nb_points();
+            std::vector<size_t> rows(n);
+            std::vector<double> dx(n), dy(n), dz(n);
+            for (size_t i=0; i<n; ++i) {
+                rows[i] = coils.sensor(i);
+                dx[i]   = coils.direction(i).x();
+                dy[i]   = coils.direction(i).y();
+                dz[i]   = coils.direction(i).z();
+            }
+
+            typedef uint32_t Mask; // One bit per integration point of a block.
+
+            const unsigned BlockSize = 32;
+
+            //  Tasks are made of whole coils with about BlockSize integration points, so that threads write disjoint
+            //  lines of mat. Their points are processed by blocks of at most BlockSize.
+
+            std::vector<size_t> tasks(1,0);
+            for (size_t s=0; s<coils.nb_sensors(); ++s)
+                if (coils.end(s)-tasks.back()>=BlockSize)
+                    tasks.push_back(coils.end(s));
+            if (tasks.back()!=n)
+                tasks.push_back(n);
+
+            const int     ntasks    = tasks.size()-1;
+            const size_t  ld        = mat.nlin();
+            double* const data      = mat.data();
+            const bool    far_field = !clusters.empty();
+
+            uint64_t exact = 0;
+            #pragma omp parallel for schedule(dynamic) reduction(+:exact)
+            for (int t=0; t<ntasks; ++t) {
+                const ThreadTimer busy;
+                for (size_t first=tasks[t]; first<tasks[t+1]; first+=BlockSize) {
+                    const unsigned size = std::min<size_t>(BlockSize,tasks[t+1]-first);
+                    const Mask     all  = (size==BlockSize) ? ~Mask(0) : (Mask(1)<<size)-1;
+                    const size_t*  row  = &rows[first];
+
+                    //  Far clusters: compute their contributions and record which points of the block see them as far.
+
+                    std::vector<Mask> far_points(clusters.size(),0);
+                    for (unsigned c=0; c<clusters.size(); ++c) {
+                        const FergusonCluster& cluster = clusters[c];
+                        double* const column = data+cluster.index*ld;
+                        for (unsigned i=0; i<size; ++i)
+                            if (cluster.far(coils.position(first+i),theta)) {
+                                column[row[i]] += cluster.field(coils.position(first+i),coils.direction(first+i));
+                                far_points[c] |= Mask(1)<<i;
+                            }
+                    }
+
+                    //  Exact evaluation for the vertices of near clusters.
+
+                    double s[BlockSize];
+                    double v[BlockSize];
+                    for (const auto& triangle : triangles) {
+                        Mask near[3] = { all, all, all };
+                        if (far_field)
+                            for (unsigned k=0; k<3; ++k)
+                                near[k] &= ~far_points[triangle.clusters[k]];
+                        const Mask needed = near[0] | near[1] | near[2];
+                        if (needed==0)
+                            continue;
+
+                        for (unsigned i=0; i<size; ++i)
+                            if (needed & (Mask(1)<<i)) {
+                                s[i] = triangle.S.f(coils.position(first+i));
+                                ++exact;
+                            } else {
+                                s[i] = 0.0;
+                            }
+
+                        for (unsigned k=0; k<3; ++k) {
+                            const Vect3&  AB     = triangle.AB[k];
+                            double* const column = data+triangle.indices[k]*ld;
+                            for (unsigned i=0; i<size; ++i)
+                                v[i] = s[i]*(AB.x()*dx[first+i]+AB.y()*dy[first+i]+AB.z()*dz[first+i]);
+                            if (near[k]==all) {
+                                for (unsigned i=0; i<size; ++i)
+                                    column[row[i]] += v[i];
+                            } else {
+                                for (unsigned i=0; i<size; ++i)
+                                    if (near[k] & (Mask(1)<<i))
+                                        column[row[i]] += v[i];
+                            }
+                        }
+                    }
+                }
             }
+            Profiler::count(Profiler::KernelEvaluations,exact);
         }
     }
+
+    // geo          = geometry
+    // mat          = storage for the projected Ferguson Matrix (must be zeroed, one line per coil)
+    // coils        = integration points where the magnetic field is to be computed, with their weighted orientations
+    // theta        = opening angle below which the far field approximation is used (0 for exact computations)
+
+    void assemble_ferguson(const Geometry& geo,Matrix& mat,const SensorCoils& coils,const double theta) {
+        const ScopedTimer timer("Ferguson");
+        FergusonKernel kernel(theta);
+        for (const auto& mesh : geo.meshes())
+            kernel.add(mesh,MagFactor*geo.conductivity_difference(mesh));
+        kernel.assemble(mat,coils);
+    }
+
+    void assemble_ferguson(const Mesh& mesh,Matrix& mat,const SensorCoils& coils,const double theta) {
+        const ScopedTimer timer("Ferguson");
+        FergusonKernel kernel(theta);
+        kernel.add(mesh,1.0);
+        kernel.assemble(mat,coils);
+    }
 }
@@ -40,6 +40,14 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #define _USE_MATH_DEFINES
 #endif
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include <om_common.h>
 #include <matrix.h>
 #include <symmatrix.h>
@@ -47,6 +55,9 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <geometry.h>
 #include <operators.h>
 #include <assemble.h>
+#include <matrix_cache.h>
+#include <assembly_checkpoint.h>
+#include <instrumentation.h>
 
 #include <constants.h>
 
@@ -74,19 +85,30 @@ namespace OpenMEEG {
             }
         }
 
-        template <typename T>
-        void deflate(T& M,const Geometry& geo) {
-            //  deflate all current barriers as one
-            for (const auto& part : geo.isolated_parts()) {
-                unsigned nb_vertices = 0;
-                unsigned i_first = 0;
+        //  The deflation of an isolated part adds M(i_first,i_first)/nb_vertices to the blocks of its outermost meshes.
+
+        struct Deflation {
+
+            Deflation(const std::vector<const Mesh*>& part) {
                 for (const auto& meshptr : part)
                     if (meshptr->outermost()){
                         nb_vertices += meshptr->vertices().size();
                         if (i_first==0)
                             i_first = meshptr->vertices().front()->index();
                     }
-                const double coef = M(i_first,i_first)/nb_vertices;
+            }
+
+            unsigned nb_vertices = 0;
+            unsigned i_first = 0;
+        };
+
+        template <typename T>
+        void deflate(T& M,const Geometry& geo) {
+            //  deflate all current barriers as one
+            const ScopedTimer timer("deflate");
+            for (const auto& part : geo.isolated_parts()) {
+                const Deflation deflation(part);
+                const double coef = M(deflation.i_first,deflation.i_first)/deflation.nb_vertices;
                 for (const auto& meshptr : part)
                     if (meshptr->outermost()) {
                         const auto& vertices = meshptr->vertices();
@@ -116,19 +138,44 @@ namespace OpenMEEG {
             const Mesh& mesh;
         };
 
-        template <typename Selector>
-        SymMatrix HeadMatrix(const Geometry& geo,const unsigned gauss_order,const Selector& disableBlock) {
+        //  Unknowns (potentials on vertices and normal currents on triangles) of a mesh in the HeadMat.
+
+        AssemblyCheckpoint::Indices unknowns(const Mesh& mesh,const size_t size) {
+            AssemblyCheckpoint::Indices indices;
+            for (const auto& vertex : mesh.vertices())
+                if (vertex->index()<size)
+                    indices.push_back(vertex->index());
+            for (const auto& triangle : mesh.triangles())
+                if (triangle.index()<size)
+                    indices.push_back(triangle.index());
+            return indices;
+        }
 
+        template <typename Selector>
+        SymMatrix HeadMatrix(const Geometry& geo,const unsigned gauss_order,const Selector& disableBlock,
+                             AssemblyCheckpoint* checkpoint=nullptr)
+        {
             SymMatrix symmatrix(geo.nb_parameters()-geo.nb_current_barrier_triangles());
             symmatrix.set(0.0);
 
             // Iterate over pairs of communicating meshes (sharing a domains) to fill the
             // lower half of the HeadMat (since it is symmetric).
+            // With a checkpoint, the blocks of each mesh pair are recorded as soon as they are computed,
+            // and the pairs recorded by a previous run are restored instead of being recomputed.
+
+            if (checkpoint!=nullptr)
+                checkpoint->restore(symmatrix);
 
+            unsigned block = 0;
             for (const auto& mp : geo.communicating_mesh_pairs()) {
                 const Mesh& mesh1 = mp(0);
                 const Mesh& mesh2 = mp(1);
 
+                if (checkpoint!=nullptr && checkpoint->completed(block)) {
+                    ++block;
+                    continue;
+                }
+
                 const double factor = mp.relative_orientation()*K;
 
                 double Ncoeff;
@@ -152,6 +199,10 @@ namespace OpenMEEG {
 
                 if (!disableBlock(mesh1,mesh2))
                     OpenMEEG::operatorN(mesh1,mesh2,symmatrix,Ncoeff,gauss_order);
+
+                if (checkpoint!=nullptr)
+                    checkpoint->save(block,unknowns(mesh1,symmatrix.nlin()),unknowns(mesh2,symmatrix.nlin()),symmatrix);
+                ++block;
             }
 
             // Deflate all current barriers as one
@@ -160,26 +211,500 @@ namespace OpenMEEG {
 
             return symmatrix;
         }
+
+        //  Global indices of the vertices and of the triangles of a mesh, in the order of the rows
+        //  (or columns) of the blocks of HeadMatBlocks.
+
+        std::vector<size_t> vertex_indices(const Mesh& mesh) {
+            std::vector<size_t> indices;
+            for (const auto& vertex : mesh.vertices())
+                indices.push_back(vertex->index());
+            return indices;
+        }
+
+        std::vector<size_t> triangle_indices(const Mesh& mesh) {
+            std::vector<size_t> indices;
+            for (const auto& triangle : mesh.triangles())
+                indices.push_back(triangle.index());
+            return indices;
+        }
+
+        //  Presents the S and N blocks of a mesh pair as a matrix indexed by the unknowns of the head matrix,
+        //  so that the operators can fill them directly. For a mesh with itself, only the upper half of the
+        //  blocks is used (as with the SymMatrix of the head matrix).
+
+        class BlockView {
+        public:
+
+            BlockView(const Geometry& geo,const Mesh& m1,const Mesh& m2,Matrix& s,Matrix& n):
+                rows(local_indices(geo,m1)),cols(local_indices(geo,m2)),triangle(geo.nb_parameters(),false),
+                symmetric(&m1==&m2),S(s),N(n)
+            {
+                for (const auto& mesh : { &m1, &m2 })
+                    for (const auto& index : triangle_indices(*mesh))
+                        triangle[index] = true;
+            }
+
+            double& operator()(const size_t i,const size_t j) const {
+                size_t r = rows[i];
+                size_t c = cols[j];
+                if (symmetric && r>c)
+                    std::swap(r,c);
+                return (triangle[i]) ? S(r,c) : N(r,c);
+            }
+
+        private:
+
+            static std::vector<size_t> local_indices(const Geometry& geo,const Mesh& mesh) {
+                std::vector<size_t> local(geo.nb_parameters());
+                for (const auto& indices : { vertex_indices(mesh), triangle_indices(mesh) })
+                    for (size_t k=0; k<indices.size(); ++k)
+                        local[indices[k]] = k;
+                return local;
+            }
+
+            const std::vector<size_t> rows;
+            const std::vector<size_t> cols;
+            std::vector<bool>         triangle;
+            const bool                symmetric;
+            Matrix&                   S;
+            Matrix&                   N;
+        };
+
+        //  M(rows[i],cols[j]) += coeff*B(i,j) (upper half only for a mesh with itself).
+
+        void add_block(SymMatrix& M,const std::vector<size_t>& rows,const std::vector<size_t>& cols,
+                       const Matrix& B,const double coeff,const bool symmetric)
+        {
+            for (size_t i=0; i<rows.size(); ++i)
+                for (size_t j=(symmetric) ? i : 0; j<cols.size(); ++j)
+                    M(rows[i],cols[j]) += coeff*B(i,j);
+        }
     }
 
-    SymMatrix conductivity_coefficients(const Geometry& geo) {
-        SymMatrix cond_coeffs(10,10);
-        for (const auto& mp : geo.communicating_mesh_pairs()) {
-            const Mesh& mesh1 = mp(0);
-            const Mesh& mesh2 = mp(1);
-            const double factor = mp.relative_orientation()*K;
-            const double Scoeff =  factor*geo.sigma_inv(mesh1,mesh2);
-            const double Ncoeff =  factor*geo.sigma(mesh1,mesh2);
-            const double Dcoeff = -factor*geo.indicator(mesh1,mesh2);
+    Matrix conductivity_coefficients(const Geometry& geo) {
+        const Geometry::MeshPairs& pairs = geo.communicating_mesh_pairs();
+        Matrix cond_coeffs(pairs.size(),2);
+        for (unsigned i=0; i<pairs.size(); ++i) {
+            const Mesh& mesh1 = pairs[i](0);
+            const Mesh& mesh2 = pairs[i](1);
+            const double factor = pairs[i].relative_orientation()*K;
+            const bool   has_S  = !mesh1.current_barrier() && !mesh2.current_barrier();
+            cond_coeffs(i,0) = (has_S) ? factor*geo.sigma_inv(mesh1,mesh2) : 0.0;
+            cond_coeffs(i,1) = factor*geo.sigma(mesh1,mesh2);
         }
         return cond_coeffs;
     }
 
     HeadMat::HeadMat(const Geometry& geo,const unsigned gauss_order) {
+        const ScopedTimer timer("HeadMat");
         SymMatrix& symmatrix = *this;
         symmatrix = Details::HeadMatrix(geo,gauss_order,Details::AllBlocks());
     }
 
+    HeadMat::HeadMat(const Geometry& geo,const unsigned gauss_order,const std::string& checkpoint_file,const bool resume) {
+        const ScopedTimer timer("HeadMat");
+        MatrixCache id("HeadMat");
+        id << geo << gauss_order;
+        AssemblyCheckpoint checkpoint(checkpoint_file,id.hash(),geo.nb_parameters()-geo.nb_current_barrier_triangles(),resume);
+        SymMatrix& symmatrix = *this;
+        symmatrix = Details::HeadMatrix(geo,gauss_order,Details::AllBlocks(),&checkpoint);
+    }
+
+    HeadMat::HeadMat(const Geometry& geo,const HeadMatBlocks& blocks) {
+        const ScopedTimer timer("HeadMat");
+        SymMatrix& symmatrix = *this;
+        symmatrix = blocks(geo);
+    }
+
+    namespace {
+
+        //  Identity of the blocks: the geometry without the conductivity values (only the non-conductive domains
+        //  matter) and the integration order.
+
+        uint64_t blocks_id(const Geometry& geo,const unsigned gauss_order) {
+            MatrixCache id("HeadMatBlocks");
+            id.add_shape(geo) << gauss_order;
+            return id.hash()();
+        }
+    }
+
+    HeadMatBlocks::HeadMatBlocks(const Geometry& geo,const unsigned order):
+        gauss_order(order),id(blocks_id(geo,order)),D(geo.nb_parameters()-geo.nb_current_barrier_triangles())
+    {
+        const ScopedTimer timer("HeadMatBlocks");
+        D.set(0.0);
+
+        //  Same operators as in Details::HeadMatrix, but the S and N blocks are computed with a unit coefficient
+        //  (operator N then uses the unscaled S block) and kept apart.
+
+        for (const auto& mp : geo.communicating_mesh_pairs()) {
+            const Mesh& mesh1 = mp(0);
+            const Mesh& mesh2 = mp(1);
+
+            const double Dcoeff = -mp.relative_orientation()*K*geo.indicator(mesh1,mesh2);
+            if (!mesh1.current_barrier())
+                OpenMEEG::operatorD(mesh1,mesh2,D,Dcoeff,gauss_order);
+
+            if (mesh1!=mesh2 && !mesh2.current_barrier())
+                OpenMEEG::operatorDstar(mesh1,mesh2,D,Dcoeff,gauss_order);
+
+            const bool has_S = !mesh1.current_barrier() && !mesh2.current_barrier();
+            Block block = { mesh1.name(), mesh2.name(), Matrix(), Matrix(mesh1.vertices().size(),mesh2.vertices().size()) };
+            if (has_S)
+                block.S = Matrix(mesh1.triangles().size(),mesh2.triangles().size());
+            block.S.set(0.0);
+            block.N.set(0.0);
+
+            Details::BlockView view(geo,mesh1,mesh2,block.S,block.N);
+            if (has_S)
+                OpenMEEG::operatorS(mesh1,mesh2,view,1.0,gauss_order);
+            OpenMEEG::operatorN(mesh1,mesh2,view,1.0,gauss_order);
+
+            blocks.push_back(block);
+        }
+    }
+
+    void HeadMatBlocks::check(const Geometry& geo) const {
+        if (blocks_id(geo,gauss_order)!=id)
+            throw std::invalid_argument("The head matrix blocks were computed for another geometry (meshes, interfaces or non-conductive domains differ).");
+    }
+
+    const HeadMatBlocks::Block& HeadMatBlocks::block(const Geometry& geo,const unsigned i) const {
+        const Geometry::MeshPairs& pairs = geo.communicating_mesh_pairs();
+        const bool consistent = blocks.size()==pairs.size() && D.nlin()==geo.nb_parameters()-geo.nb_current_barrier_triangles();
+        if (consistent) {
+            const Mesh&  mesh1 = pairs[i](0);
+            const Mesh&  mesh2 = pairs[i](1);
+            const Block& block = blocks[i];
+            const bool   has_S = !mesh1.current_barrier() && !mesh2.current_barrier();
+            if (block.mesh1==mesh1.name() && block.mesh2==mesh2.name() &&
+                block.N.nlin()==mesh1.vertices().size() && block.N.ncol()==mesh2.vertices().size() &&
+                block.S.nlin()==((has_S) ? mesh1.triangles().size() : 0) && block.S.ncol()==((has_S) ? mesh2.triangles().size() : 0))
+                return block;
+        }
+        throw std::invalid_argument("The head matrix blocks do not match the geometry (meshes or non-conductive domains differ).");
+    }
+
+    SymMatrix HeadMatBlocks::operator()(const Geometry& geo) const {
+        const ScopedTimer timer("HeadMat recombination");
+
+        check(geo);
+
+        SymMatrix symmatrix(D,DEEP_COPY);
+        const Matrix& coeffs = conductivity_coefficients(geo);
+        const Geometry::MeshPairs& pairs = geo.communicating_mesh_pairs();
+        for (unsigned i=0; i<pairs.size(); ++i) {
+            const Block& blk = block(geo,i);
+            const Mesh& mesh1 = pairs[i](0);
+            const Mesh& mesh2 = pairs[i](1);
+            const bool symmetric = &mesh1==&mesh2;
+            if (blk.S.nlin()!=0)
+                Details::add_block(symmatrix,Details::triangle_indices(mesh1),Details::triangle_indices(mesh2),blk.S,coeffs(i,0),symmetric);
+            Details::add_block(symmatrix,Details::vertex_indices(mesh1),Details::vertex_indices(mesh2),blk.N,coeffs(i,1),symmetric);
+        }
+
+        Details::deflate(symmatrix,geo);
+
+        return symmatrix;
+    }
+
+    //  File layout (native endianness): magic, version, identity (hash of the geometry and of the integration order),
+    //  integration order, matrix size, number of blocks, the values of D (packed
+    //  upper triangle), then for each block the two mesh names (length and characters), and the dimensions and
+    //  values (column major) of S and N.
+
+    namespace {
+
+        const char     BlocksTag[8]  = "OMHMBLK";
+        const uint32_t BlocksVersion = 2;
+
+        template <typename T>
+        void write(std::ostream& os,const T& value) { os.write(reinterpret_cast<const char*>(&value),sizeof(T)); }
+
+        template <typename T>
+        bool read(std::istream& is,T& value) { return static_cast<bool>(is.read(reinterpret_cast<char*>(&value),sizeof(T))); }
+
+        void write(std::ostream& os,const std::string& str) {
+            write(os,static_cast<uint64_t>(str.size()));
+            os.write(str.data(),str.size());
+        }
+
+        bool read(std::istream& is,std::string& str) {
+            uint64_t size;
+            if (!read(is,size))
+                return false;
+            str.resize(size);
+            return static_cast<bool>(is.read(&str[0],size));
+        }
+
+        void write(std::ostream& os,const Matrix& M) {
+            write(os,static_cast<uint64_t>(M.nlin()));
+            write(os,static_cast<uint64_t>(M.ncol()));
+            os.write(reinterpret_cast<const char*>(M.data()),M.size()*sizeof(double));
+        }
+
+        bool read(std::istream& is,Matrix& M) {
+            uint64_t nlin,ncol;
+            if (!read(is,nlin) || !read(is,ncol))
+                return false;
+            M = (nlin*ncol==0) ? Matrix() : Matrix(nlin,ncol);
+            return static_cast<bool>(is.read(reinterpret_cast<char*>(M.data()),M.size()*sizeof(double)));
+        }
+    }
+
+    void HeadMatBlocks::save(const std::string& filename) const {
+        std::ofstream os(filename,std::ios::binary);
+        if (!os)
+            throw OpenError(filename);
+
+        os.write(BlocksTag,sizeof(BlocksTag));
+        write(os,BlocksVersion);
+        write(os,id);
+        write(os,static_cast<uint32_t>(gauss_order));
+        write(os,static_cast<uint64_t>(D.nlin()));
+        write(os,static_cast<uint64_t>(blocks.size()));
+        os.write(reinterpret_cast<const char*>(D.data()),D.size()*sizeof(double));
+        for (const auto& block : blocks) {
+            write(os,block.mesh1);
+            write(os,block.mesh2);
+            write(os,block.S);
+            write(os,block.N);
+        }
+        if (!os)
+            throw OpenError(filename);
+    }
+
+    void HeadMatBlocks::load(const std::string& filename,const Geometry& geo,const unsigned order) {
+        std::ifstream is(filename,std::ios::binary);
+        if (!is)
+            throw OpenError(filename);
+
+        char     magic[sizeof(BlocksTag)];
+        uint32_t version,stored_order;
+        uint64_t stored_id,size,nblocks;
+        if (!is.read(magic,sizeof(magic)) || std::memcmp(magic,BlocksTag,sizeof(BlocksTag))!=0 ||
+            !read(is,version) || version!=BlocksVersion || !read(is,stored_id) || !read(is,stored_order) ||
+            !read(is,size) || !read(is,nblocks))
+            throw BadHeader(is,"head matrix blocks");
+
+        if (stored_order!=order || stored_id!=blocks_id(geo,order))
+            throw std::invalid_argument("The head matrix blocks of "+filename+" were computed for another geometry or integration order.");
+
+        gauss_order = order;
+        id          = stored_id;
+
+        D = SymMatrix(size);
+        blocks.resize(nblocks);
+        bool ok = static_cast<bool>(is.read(reinterpret_cast<char*>(D.data()),D.size()*sizeof(double)));
+        for (auto& block : blocks)
+            ok = ok && read(is,block.mesh1) && read(is,block.mesh2) && read(is,block.S) && read(is,block.N);
+        if (!ok)
+            throw BadData(is,"head matrix blocks");
+    }
+
+    ConductivitySweep::ConductivitySweep(const Geometry& geo,const HeadMatBlocks& blocks,const std::string& domain_name,
+                                         const Matrix& B):
+        sigma0(geo.domain(domain_name).conductivity())
+    {
+        const ScopedTimer timer("ConductivitySweep");
+
+        if (sigma0==0.0)
+            throw std::invalid_argument("The conductivity of a non-conductive domain cannot be changed.");
+
+        const SymMatrix& H    = blocks(geo);
+        const size_t     size = H.nlin();
+        om_assert(B.nlin()==size);
+
+        //  The unknowns a are those of the meshes of the pairs whose common domains include the swept one,
+        //  and the vertices of the outermost meshes whose deflation depends on a diagonal element of these.
+
+        const Domain* domain = &geo.domain(domain_name);
+        auto bounds = [&](const Mesh& mesh) {
+            const Geometry::DomainsReference& domains = geo.domains(mesh);
+            return std::find(domains.begin(),domains.end(),domain)!=domains.end();
+        };
+
+        const Geometry::MeshPairs& pairs = geo.communicating_mesh_pairs();
+        std::vector<bool> swept(pairs.size(),false);
+        std::vector<bool> updated(size,false);
+        for (unsigned i=0; i<pairs.size(); ++i)
+            if (bounds(pairs[i](0)) && bounds(pairs[i](1))) {
+                swept[i] = true;
+                for (unsigned k=0; k<2; ++k)
+                    for (const auto& indices : { Details::vertex_indices(pairs[i](k)),Details::triangle_indices(pairs[i](k)) })
+                        for (const auto& index : indices)
+                            if (index<size)
+                                updated[index] = true;
+            }
+
+        std::vector<bool> deflated(geo.isolated_parts().size(),false);
+        for (unsigned p=0; p<geo.isolated_parts().size(); ++p) {
+            const auto& part = geo.isolated_parts()[p];
+            if (updated[Details::Deflation(part).i_first]) {
+                deflated[p] = true;
+                for (const auto& meshptr : part)
+                    if (meshptr->outermost())
+                        for (const auto& index : Details::vertex_indices(*meshptr))
+                            updated[index] = true;
+            }
+        }
+
+        std::vector<size_t> local(size);
+        for (size_t i=0; i<size; ++i) {
+            std::vector<size_t>& unknowns = (updated[i]) ? affected : others;
+            local[i] = unknowns.size();
+            unknowns.push_back(i);
+        }
+
+        auto local_indices = [&](const std::vector<size_t>& indices) {
+            std::vector<size_t> result;
+            for (const auto& index : indices)
+                result.push_back(local[index]);
+            return result;
+        };
+
+        //  Variations of H_aa: the S and N blocks of the swept pairs (the coefficients a_p and b_p of these pairs
+        //  vary as 1/sigma and sigma), and the corresponding variation of the deflation.
+
+        const size_t na = affected.size();
+        const size_t nu = others.size();
+
+        SymMatrix dS(na);
+        SymMatrix dN(na);
+        dS.set(0.0);
+        dN.set(0.0);
+        for (unsigned i=0; i<pairs.size(); ++i)
+            if (swept[i]) {
+                const HeadMatBlocks::Block& block = blocks.block(geo,i);
+                const Mesh& mesh1 = pairs[i](0);
+                const Mesh& mesh2 = pairs[i](1);
+                const double factor = pairs[i].relative_orientation()*K;
+                const bool symmetric = &mesh1==&mesh2;
+                if (block.S.nlin()!=0)
+                    Details::add_block(dS,local_indices(Details::triangle_indices(mesh1)),local_indices(Details::triangle_indices(mesh2)),
+                                       block.S,factor,symmetric);
+                Details::add_block(dN,local_indices(Details::vertex_indices(mesh1)),local_indices(Details::vertex_indices(mesh2)),
+                                   block.N,factor,symmetric);
+            }
+
+        for (unsigned p=0; p<geo.isolated_parts().size(); ++p)
+            if (deflated[p]) {
+                const auto& part = geo.isolated_parts()[p];
+                const Details::Deflation deflation(part);
+                const size_t first = local[deflation.i_first];
+                for (auto* M : { &dS,&dN }) {
+                    const double coef = (*M)(first,first)/deflation.nb_vertices;
+                    for (const auto& meshptr : part)
+                        if (meshptr->outermost()) {
+                            const std::vector<size_t>& vertices = local_indices(Details::vertex_indices(*meshptr));
+                            for (size_t k1=0; k1<vertices.size(); ++k1)
+                                for (size_t k2=k1; k2<vertices.size(); ++k2)
+                                    (*M)(vertices[k1],vertices[k2]) += coef;
+                        }
+                }
+            }
+
+        //  Elimination of the unknowns u: H_uu^{-1} [ H_ua B_u ] with a single factorization.
+
+        Matrix Hua(nu,na);
+        Matrix C(nu,na+B.ncol());
+        SymMatrix Huu(nu);
+        for (size_t i=0; i<nu; ++i) {
+            for (size_t j=i; j<nu; ++j)
+                Huu(i,j) = H(others[i],others[j]);
+            for (size_t j=0; j<na; ++j)
+                C(i,j) = Hua(i,j) = H(others[i],affected[j]);
+            for (size_t j=0; j<B.ncol(); ++j)
+                C(i,na+j) = B(others[i],j);
+        }
+
+        SymMatrix schur(na);
+        Matrix    Ba(na,B.ncol());
+        for (size_t i=0; i<na; ++i) {
+            for (size_t j=i; j<na; ++j)
+                schur(i,j) = H(affected[i],affected[j]);
+            for (size_t j=0; j<B.ncol(); ++j)
+                Ba(i,j) = B(affected[i],j);
+        }
+
+        if (nu!=0) {
+            Huu.solveLin(C);
+            Z = C.submat(0,nu,0,na);
+            Y = C.submat(0,nu,na,B.ncol());
+
+            const Matrix& HZ = Hua.tmult(C);
+            for (size_t i=0; i<na; ++i) {
+                for (size_t j=i; j<na; ++j)
+                    schur(i,j) -= HZ(i,j);
+                for (size_t j=0; j<B.ncol(); ++j)
+                    Ba(i,j) -= HZ(i,na+j);
+            }
+        }
+
+        //  sigma S(sigma) = dS+sigma A+sigma^2 dN with A = S(sigma0)-dS/sigma0-sigma0 dN. The quadratic term only involves the
+        //  non zero lines v of dN: with y = sigma x_v, sigma S(sigma) x = sigma Ba is linearized as (P+sigma R) [x;y] = [sigma Ba;0]
+        //  with P = [dS 0;0 I] and R = [A dN_v;-I_v 0]. P+sigma R = L0 (I+(sigma-sigma0) L0^{-1} R), where L0 = P+sigma0 R is
+        //  invertible as S(sigma0) is, and L0^{-1} R is reduced once.
+
+        std::vector<size_t> v;
+        for (size_t i=0; i<na; ++i)
+            for (size_t j=0; j<na; ++j)
+                if (dN(i,j)!=0.0) {
+                    v.push_back(i);
+                    break;
+                }
+
+        const size_t m = na+v.size();
+        Matrix P(m,m);
+        Matrix R(m,m);
+        P.set(0.0);
+        R.set(0.0);
+        for (size_t i=0; i<na; ++i)
+            for (size_t j=0; j<na; ++j) {
+                P(i,j) = dS(i,j);
+                R(i,j) = schur(i,j)-dS(i,j)/sigma0-sigma0*dN(i,j);
+            }
+        for (size_t k=0; k<v.size(); ++k) {
+            P(na+k,na+k) = 1.0;
+            R(na+k,v[k]) = -1.0;
+            for (size_t i=0; i<na; ++i)
+                R(i,na+k) = dN(i,v[k]);
+        }
+
+        const Matrix& L0inv = (P+R*sigma0).inverse();
+        pencil = ShiftedSolver(L0inv*R,L0inv.submat(0,m,0,na)*Ba);
+
+        std::cout << "Conductivity sweep of domain " << domain_name << ": " << na << " of " << size
+                  << " unknowns are updated." << std::endl;
+    }
+
+    Matrix ConductivitySweep::solve(const double sigma) const {
+        const ScopedTimer timer("ConductivitySweep solve");
+
+        if (sigma==0.0)
+            throw std::invalid_argument("The conductivity of a domain cannot be changed to zero.");
+
+        //  No factorization: [x;y] = sigma (I+(sigma-sigma0) L0^{-1} R)^{-1} L0^{-1} [Ba;0].
+
+        const Matrix& W  = pencil.solve(sigma-sigma0);
+        const Matrix& Xa = W.submat(0,affected.size(),0,W.ncol())*sigma;
+
+        Matrix X(affected.size()+others.size(),W.ncol());
+        for (size_t i=0; i<affected.size(); ++i)
+            for (size_t j=0; j<X.ncol(); ++j)
+                X(affected[i],j) = Xa(i,j);
+
+        if (!others.empty()) {
+            const Matrix& Xu = Y-Z*Xa;
+            for (size_t i=0; i<others.size(); ++i)
+                for (size_t j=0; j<X.ncol(); ++j)
+                    X(others[i],j) = Xu(i,j);
+        }
+
+        return X;
+    }
+
     Matrix HeadMatrix(const Geometry& geo,const Interface& Cortex,const unsigned gauss_order,const unsigned extension=0) {
 
         const Mesh& cortex = Cortex.oriented_meshes().front().mesh();
@@ -253,13 +778,12 @@ namespace OpenMEEG {
         /// Choose Regularization parameter
 
         const Matrix MM(M.transpose()*M);
-        SparseMatrix alphas(Nc,Nc); // diagonal matrix
+        SparseMatrix::Builder alphas(Nc,Nc); // diagonal matrix
         Matrix Z;
         double alpha1 = alpha;
         double beta1  = beta;
         if (alpha1<0) { // try an automatic method... TODO find better estimation
             const double nRR_v = RR.submat(0,geo.vertices().size(),0,geo.vertices().size()).frobenius_norm();
-            alphas.set(0.);
             alpha1 = MM.frobenius_norm()/(1.e3*nRR_v);
             beta1  = alpha1*50000.;
             std::cout << "AUTOMATIC alphas = " << alpha1 << "\tbeta = " << beta1 << std::endl;
@@ -268,14 +792,14 @@ namespace OpenMEEG {
         }
 
         for (const auto& vertex : geo.vertices())
-            alphas(vertex.index(),vertex.index()) = alpha1;
+            alphas.insert(vertex.index(),vertex.index(),alpha1);
 
         for (const auto& mesh : geo.meshes())
             if (!mesh.current_barrier() )
                 for (const auto& triangle : mesh.triangles())
-                    alphas(triangle.index(),triangle.index()) = beta1;
+                    alphas.insert(triangle.index(),triangle.index(),beta1);
 
-        Z = P.transpose()*(MM+alphas*RR)*P;
+        Z = P.transpose()*(MM+SparseMatrix(alphas)*RR)*P;
 
         // ** PseudoInverse and return **
         // X = P * { (M*P)' * (M*P) + (R*P)' * (R*P) }¡(-1) * (M*P)'m
@@ -361,7 +885,24 @@ namespace OpenMEEG {
         mat = (G*H.transpose()*(H*G*H.transpose()).inverse()).submat(0,Nc,Nl,M.nlin());
     }
 
-    Surf2VolMat::Surf2VolMat(const Geometry& geo,const Matrix& points) {
+    namespace {
+
+        //  Potential at the points (grouped by domain) from the surface potentials and normal currents.
+
+        void assemble_surf2vol(const Geometry& geo,Matrix& mat,const std::map<const Domain*,Vertices>& points,const double theta) {
+            const ScopedTimer timer("Surf2VolMat");
+            for (const auto& map_element : points)
+                for (const auto& mesh : geo.meshes()) {
+                    const int orientation = map_element.first->mesh_orientation(mesh);
+                    if (orientation!=0) {
+                        const double coeffS = (mesh.current_barrier()) ? 0.0 : orientation*K/map_element.first->conductivity();
+                        operatorInternal(mesh,mat,map_element.second,-orientation*K,coeffS,theta);
+                    }
+                }
+        }
+    }
+
+    Surf2VolMat::Surf2VolMat(const Geometry& geo,const Matrix& points,const double theta) {
 
         // Find the points per domain and generate the indices for the m_points
 
@@ -386,14 +927,34 @@ namespace OpenMEEG {
         mat = Matrix(size,(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
         mat.set(0.0);
 
-        for (const auto& map_element : m_points)
-            for (const auto& mesh : geo.meshes()) {
-                const int orientation = map_element.first->mesh_orientation(mesh);
-                if (orientation!=0) {
-                    operatorDinternal(mesh,mat,map_element.second,-orientation*K);
-                    if (!mesh.current_barrier())
-                        operatorSinternal(mesh,mat,map_element.second,orientation*K/map_element.first->conductivity());
-                }
+        assemble_surf2vol(geo,mat,m_points,theta);
+    }
+
+    Surf2VolMat::Surf2VolMat(const Geometry& geo,const RectilinearGrid& grid,const double theta) {
+
+        // All the grid points are kept (so that the result can be saved on the grid): the lines of the points
+        // in non-conductive domains are left to zero.
+
+        const std::vector<const Domain*>& domains = grid.domains(geo);
+
+        std::map<const Domain*,Vertices> m_points;
+        unsigned dropped = 0;
+        for (unsigned i=0;i<grid.nb_points();++i)
+            if (domains[i]->conductivity()==0.0) {
+                ++dropped;
+            } else {
+                const Vect3& p = grid.point(i);
+                m_points[domains[i]].push_back(Vertex(p.x(),p.y(),p.z(),i));
             }
+
+        if (dropped!=0)
+            std::cerr << " Surf2Vol: " << dropped << " grid points are inside a non-conductive domain. Their potential is set to 0." << std::endl;
+
+        Matrix& mat = *this;
+
+        mat = Matrix(grid.nb_points(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
+        mat.set(0.0);
+
+        assemble_surf2vol(geo,mat,m_points,theta);
     }
 }
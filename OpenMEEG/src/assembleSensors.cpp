@@ -37,17 +37,25 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
 #include <assemble.h>
 #include <danielsson.h>
 #include <operators.h>
 #include <sensors.h>
+#include <instrumentation.h>
 
 #include <constants.h>
 #include <sparse_matrix.h>
 
 namespace OpenMEEG {
 
-    void assemble_ferguson(const Geometry& geo,Matrix& mat,const Matrix& pts);
+    void assemble_ferguson(const Geometry& geo,Matrix& mat,const SensorCoils& coils,const double theta);
+    void assemble_ferguson(const Mesh& mesh,Matrix& mat,const SensorCoils& coils,const double theta);
 
     // EEG patches positions are reported line by line in the positions Matrix
     // mat is supposed to be filled with zeros
@@ -58,7 +66,8 @@ namespace OpenMEEG {
 
         const Matrix& positions = electrodes.getPositions();
 
-        mat = SparseMatrix(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
+        SparseMatrix::Builder builder(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
+        builder.reserve(3*positions.nlin());
 
         for (unsigned i=0;i<positions.nlin();++i) {
             const Vect3 current_position(positions(i,0),positions(i,1),positions(i,2));
@@ -67,8 +76,10 @@ namespace OpenMEEG {
             Triangle current_triangle;
             dist_point_geom(current_position,geo,current_alphas,current_triangle,dist);
             for (unsigned j=0;j<3;++j)
-                mat(i,current_triangle.vertex(j).index()) = current_alphas(j);
+                builder.insert(i,current_triangle.vertex(j).index(),current_alphas(j));
         }
+
+        mat = SparseMatrix(builder);
     }
 
     // ECoG positions are reported line by line in the positions Matrix
@@ -81,7 +92,8 @@ namespace OpenMEEG {
 
         const Matrix& positions = electrodes.getPositions();
 
-        mat = SparseMatrix(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
+        SparseMatrix::Builder builder(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
+        builder.reserve(3*positions.nlin());
 
         for (unsigned it=0;it<positions.nlin();++it) {
             Vect3 current_position;
@@ -91,72 +103,116 @@ namespace OpenMEEG {
             Triangle current_triangle;
             dist_point_interface(current_position,i,current_alphas,current_triangle);
             for (unsigned j=0;j<3;++j)
-                mat(it,current_triangle.vertex(j).index()) = current_alphas(j);
+                builder.insert(it,current_triangle.vertex(j).index(),current_alphas(j));
         }
+
+        mat = SparseMatrix(builder);
     }
 
     // MEG patches positions are reported line by line in the positions Matrix (same for positions)
     // mat is supposed to be filled with zeros
     // mat is the linear application which maps x (the unknown vector in symmetric system) -> bFerguson (contrib to MEG response)
 
-    Head2MEGMat::Head2MEGMat(const Geometry& geo,const Sensors& sensors) {
+    Head2MEGMat::Head2MEGMat(const Geometry& geo,const Sensors& sensors,const double theta) {
         Matrix& mat = *this;
 
-        const Matrix& positions    = sensors.getPositions();
-        const Matrix& orientations = sensors.getOrientations();
-        const unsigned nbIntegrationPoints = sensors.getNumberOfPositions();
+        const SensorCoils coils(sensors);
         unsigned p0_p1_size = geo.nb_parameters()-geo.nb_current_barrier_triangles();
 
-        Matrix FergusonMat(3*nbIntegrationPoints,geo.vertices().size());
-        FergusonMat.set(0.0);
-
-        assemble_ferguson(geo,FergusonMat,positions);
-
-        mat = Matrix(nbIntegrationPoints,p0_p1_size);
+        mat = Matrix(coils.nb_sensors(),p0_p1_size);
         mat.set(0.0);
 
-        ProgressBar pb(nbIntegrationPoints);
-        for (unsigned i=0; i<nbIntegrationPoints; ++i,++pb) {
-            for (const auto& vertex : geo.vertices()) {
-                const Vect3 fergusonField(FergusonMat(3*i,vertex.index()),
-                                          FergusonMat(3*i+1,vertex.index()),
-                                          FergusonMat(3*i+2,vertex.index()));
-                const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
-                mat(i,vertex.index()) = dotprod(fergusonField,direction)/direction.norm();
+        assemble_ferguson(geo,mat,coils,theta); // Weights are applied on the fly
+    }
+
+    namespace {
+
+        //  Line of the previous matrix for each coil whose integration points are unchanged, or none for the
+        //  sensors which moved (or are new). Sensors are matched by name when both sets are named, by index otherwise.
+
+        const size_t none = std::numeric_limits<size_t>::max();
+
+        std::vector<size_t> previous_lines(const Sensors& sensors,const SensorCoils& coils,
+                                           const Sensors& previous_sensors,const SensorCoils& previous_coils)
+        {
+            const bool by_name = sensors.hasNames() && previous_sensors.hasNames();
+            std::vector<size_t> lines(coils.nb_sensors(),none);
+            for (size_t s=0; s<coils.nb_sensors(); ++s) {
+                size_t p = s;
+                if (by_name) {
+                    const std::string& name = sensors.getName(s);
+                    if (!previous_sensors.hasSensor(name))
+                        continue;
+                    p = previous_sensors.getSensorIdx(name);
+                } else if (p>=previous_coils.nb_sensors()) {
+                    continue;
+                }
+
+                const size_t n = coils.end(s)-coils.begin(s);
+                if (previous_coils.end(p)-previous_coils.begin(p)!=n)
+                    continue;
+
+                bool unchanged = true;
+                for (size_t i=coils.begin(s),j=previous_coils.begin(p); i<coils.end(s) && unchanged; ++i,++j)
+                    unchanged = coils.position(i)==previous_coils.position(j) && coils.direction(i)==previous_coils.direction(j);
+                if (unchanged)
+                    lines[s] = p;
             }
+            return lines;
         }
-        mat = sensors.getWeightsMatrix()*mat; // Apply weights
+    }
+
+    Head2MEGMat::Head2MEGMat(const Geometry& geo,const Sensors& sensors,const Sensors& previous_sensors,
+                             const Matrix& previous_mat,const double theta)
+    {
+        Matrix& mat = *this;
+
+        const SensorCoils coils(sensors);
+        const SensorCoils previous_coils(previous_sensors);
+        unsigned p0_p1_size = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+
+        if (previous_mat.nlin()!=previous_coils.nb_sensors() || previous_mat.ncol()!=p0_p1_size)
+            throw std::invalid_argument("Head2MEGMat: the previous matrix does not match the previous sensors or the geometry.");
+
+        mat = Matrix(coils.nb_sensors(),p0_p1_size);
+
+        const std::vector<size_t>& lines = previous_lines(sensors,coils,previous_sensors,previous_coils);
+        std::vector<size_t> moved;
+        for (size_t s=0; s<coils.nb_sensors(); ++s)
+            if (lines[s]==none) {
+                moved.push_back(s);
+            } else {
+                mat.setlin(s,previous_mat.getlin(lines[s]));
+            }
+
+        std::cout << "Head2MEGMat: " << moved.size() << " of " << coils.nb_sensors() << " sensors moved." << std::endl;
+        if (moved.empty())
+            return;
+
+        const SensorCoils moved_coils(sensors,moved);
+        Matrix moved_mat(moved_coils.nb_sensors(),p0_p1_size);
+        moved_mat.set(0.0);
+
+        assemble_ferguson(geo,moved_mat,moved_coils,theta); // Weights are applied on the fly
+
+        for (size_t k=0; k<moved.size(); ++k)
+            mat.setlin(moved[k],moved_mat.getlin(k));
     }
 
     // MEG patches positions are reported line by line in the positions Matrix (same for positions)
     // mat is supposed to be filled with zeros
     // mat is the linear application which maps x (the unknown vector in symmetric system) -> binf (contrib to MEG response)
 
-    SurfSource2MEGMat::SurfSource2MEGMat(const Mesh& sources_mesh,const Sensors& sensors) {
+    SurfSource2MEGMat::SurfSource2MEGMat(const Mesh& sources_mesh,const Sensors& sensors,const double theta) {
 
         Matrix& mat = *this;
 
-        const Matrix& positions    = sensors.getPositions();
-        const Matrix& orientations = sensors.getOrientations();
-        const unsigned nsquids = positions.nlin();
+        const SensorCoils coils(sensors);
 
-        mat = Matrix(nsquids,sources_mesh.vertices().size());
+        mat = Matrix(coils.nb_sensors(),sources_mesh.vertices().size());
         mat.set(0.0);
 
-        ProgressBar pb(nsquids);
-        for (unsigned i=0; i<nsquids; ++i,++pb) {
-            Vect3 p(positions(i,0),positions(i,1),positions(i,2));
-            Matrix FergusonMat(3,mat.ncol());
-            FergusonMat.set(0.0);
-            operatorFerguson(p,sources_mesh,FergusonMat,0,1.);
-            for (unsigned j=0;j<mat.ncol();++j) {
-                const Vect3 fergusonField(FergusonMat(0,j),FergusonMat(1,j),FergusonMat(2,j));
-                const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
-                mat(i,j) = dotprod(fergusonField,direction)/direction.norm();
-            }
-        }
-
-        mat = sensors.getWeightsMatrix()*mat; // Apply weights
+        assemble_ferguson(sources_mesh,mat,coils,theta); // Weights are applied on the fly
     }
 
     // Creates the DipSource2MEG Matrix with unconstrained orientations for the sources.
@@ -166,32 +222,74 @@ namespace OpenMEEG {
 
     DipSource2MEGMat::DipSource2MEGMat(const Matrix& dipoles,const Sensors& sensors) {
 
-        Matrix& mat = *this;
+        const ScopedTimer timer("DipSource2MEGMat");
 
-        const Matrix& positions    = sensors.getPositions();
-        const Matrix& orientations = sensors.getOrientations();
+        Matrix& mat = *this;
 
         if ( dipoles.ncol() != 6) {
             std::cerr << "Dipoles File Format Error" << std::endl;
             exit(1);
         }
 
+        // The following routine is the equivalent of operatorFerguson for point-like dipoles.
+        // The integration points are preloaded per coil (structure of arrays) with their orientations scaled by
+        // MagFactor and by their weights, so that the field of a dipole is a single contiguous loop over the points
+        // folded directly in the lines of the coils.
+
+        const SensorCoils coils(sensors);
+
+        const size_t npts = coils.nb_points();
+        std::vector<size_t> sensor(npts);
+        std::vector<double> px(npts),py(npts),pz(npts),dx(npts),dy(npts),dz(npts);
+        for (size_t k=0;k<npts;++k) {
+            const Vect3& position  = coils.position(k);
+            const Vect3& direction = coils.direction(k);
+            sensor[k] = coils.sensor(k);
+            px[k] = position(0);
+            py[k] = position(1);
+            pz[k] = position(2);
+            dx[k] = MagFactor*direction(0);
+            dy[k] = MagFactor*direction(1);
+            dz[k] = MagFactor*direction(2);
+        }
+
         // this Matrix will contain the field generated at the location of the i-th squid by the j-th source
-        mat = Matrix(positions.nlin(),dipoles.nlin());
 
-        // The following routine is the equivalent of operatorFerguson for point-like dipoles.
+        mat = Matrix(coils.nb_sensors(),dipoles.nlin());
+        mat.set(0.0);
 
-        for (unsigned i=0;i<mat.nlin();++i)
-            for (unsigned j=0;j<mat.ncol();++j) {
-                const Vect3 r(dipoles(j,0),dipoles(j,1),dipoles(j,2));
-                const Vect3 q(dipoles(j,3),dipoles(j,4),dipoles(j,5));
-                const Vect3& diff = Vect3(positions(i,0),positions(i,1),positions(i,2))-r;
-                const double norm_diff = diff.norm();
-                const Vect3 fergusonField = q ^ diff / (norm_diff * norm_diff * norm_diff);
-                const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
-                mat(i,j) = dotprod(fergusonField,direction)*MagFactor/direction.norm();
+        const size_t ld   = mat.nlin();
+        double* const data = mat.data();
+
+        #pragma omp parallel
+        {
+            std::vector<double> field(npts);
+
+            #pragma omp for schedule(dynamic)
+            for (int j=0;j<static_cast<int>(dipoles.nlin());++j) {
+                const ThreadTimer busy;
+                const double rx = dipoles(j,0), ry = dipoles(j,1), rz = dipoles(j,2);
+                const double qx = dipoles(j,3), qy = dipoles(j,4), qz = dipoles(j,5);
+
+                // (q ^ diff) . direction / |diff|^3 = q . (diff ^ direction) / |diff|^3
+
+                for (size_t k=0;k<npts;++k) {
+                    const double ux = px[k]-rx;
+                    const double uy = py[k]-ry;
+                    const double uz = pz[k]-rz;
+                    const double n2 = ux*ux+uy*uy+uz*uz;
+                    const double cx = uy*dz[k]-uz*dy[k];
+                    const double cy = uz*dx[k]-ux*dz[k];
+                    const double cz = ux*dy[k]-uy*dx[k];
+                    field[k] = (qx*cx+qy*cy+qz*cz)/(n2*std::sqrt(n2));
+                }
+
+                double* const column = data+j*ld;
+                for (size_t k=0;k<npts;++k)
+                    column[sensor[k]] += field[k];
             }
+        }
 
-        mat = sensors.getWeightsMatrix()*mat; // Apply weights
+        Profiler::count(Profiler::KernelEvaluations,npts*dipoles.nlin());
     }
 }
@@ -37,6 +37,9 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <map>
+#include <vector>
+
 #include <vector.h>
 #include <matrix.h>
 #include <danielsson.h>
@@ -94,6 +97,20 @@ namespace OpenMEEG {
     DipSourceMat::DipSourceMat(const Geometry& geo,const Matrix& dipoles,const unsigned gauss_order,
                                const bool adapt_rhs,const std::string& domain_name)
     {
+        ProgressBar pb(dipoles.nlin());
+        assemble(geo,dipoles,pb,gauss_order,adapt_rhs,domain_name);
+    }
+
+    DipSourceMat::DipSourceMat(const Geometry& geo,const Matrix& dipoles,ProgressBar& pb,const unsigned gauss_order,
+                               const bool adapt_rhs,const std::string& domain_name)
+    {
+        assemble(geo,dipoles,pb,gauss_order,adapt_rhs,domain_name);
+    }
+
+    void DipSourceMat::assemble(const Geometry& geo,const Matrix& dipoles,ProgressBar& pb,const unsigned gauss_order,
+                                const bool adapt_rhs,const std::string& domain_name)
+    {
+        const ScopedTimer timer("DipSourceMat");
         Matrix& rhs = *this;
 
         const size_t size      = geo.nb_parameters()-geo.nb_current_barrier_triangles();
@@ -102,40 +119,50 @@ namespace OpenMEEG {
         rhs = Matrix(size,n_dipoles);
         rhs.set(0.0);
 
-        ProgressBar pb(n_dipoles);
-        Vector rhs_col(rhs.nlin());
-        for (unsigned s=0; s<n_dipoles; ++s,++pb) {
-            const Vect3 r(dipoles(s,0),dipoles(s,1),dipoles(s,2));
-            const Vect3 q(dipoles(s,3),dipoles(s,4),dipoles(s,5));
-
-            const Domain domain = (domain_name=="") ? geo.domain(r) : geo.domain(domain_name);
-
-            //  Only consider dipoles in non-zero conductivity domain.
-
-            const double cond = domain.conductivity();
-            if (cond!=0.0) {
-                rhs_col.set(0.0);
-                const double K = 1.0/(4*Pi);
-                for (const auto& boundary : domain.boundaries()) { //  Iterate over the domain's interfaces (half-spaces)
-                    const double factorD = (boundary.inside()) ? K : -K;
-                    for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) { //  Iterate over the meshes of the interface
-                        //  Treat the mesh.
-                        const double coeffD = factorD*oriented_mesh.orientation();
-                        const Mesh&  mesh   = oriented_mesh.mesh();
-                        operatorDipolePotDer(r,q,mesh,rhs_col,coeffD,gauss_order,adapt_rhs);
-
-                        if (!oriented_mesh.mesh().current_barrier()) {
-                            const double coeff = -coeffD/cond;;
-                            operatorDipolePot(r,q,mesh,rhs_col,coeff,gauss_order,adapt_rhs);
+        const Domain* named_domain = (domain_name=="") ? nullptr : &geo.domain(domain_name);
+
+        //  The columns are computed in parallel over the dipoles (the operators then run sequentially in each thread).
+
+        #pragma omp parallel
+        {
+            Vector rhs_col(size);
+
+            #pragma omp for schedule(dynamic)
+            for (int s=0; s<static_cast<int>(n_dipoles); ++s) {
+                const Vect3 r(dipoles(s,0),dipoles(s,1),dipoles(s,2));
+                const Vect3 q(dipoles(s,3),dipoles(s,4),dipoles(s,5));
+
+                const Domain& domain = (named_domain==nullptr) ? geo.domain(r) : *named_domain;
+
+                //  Only consider dipoles in non-zero conductivity domain.
+
+                const double cond = domain.conductivity();
+                if (cond!=0.0) {
+                    rhs_col.set(0.0);
+                    const double K = 1.0/(4*Pi);
+                    for (const auto& boundary : domain.boundaries()) { //  Iterate over the domain's interfaces (half-spaces)
+                        const double factorD = (boundary.inside()) ? K : -K;
+                        for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) { //  Iterate over the meshes of the interface
+                            //  Treat the mesh.
+                            const double coeffD = factorD*oriented_mesh.orientation();
+                            const Mesh&  mesh   = oriented_mesh.mesh();
+                            operatorDipolePotDer(r,q,mesh,rhs_col,coeffD,gauss_order,adapt_rhs);
+
+                            if (!oriented_mesh.mesh().current_barrier()) {
+                                const double coeff = -coeffD/cond;;
+                                operatorDipolePot(r,q,mesh,rhs_col,coeff,gauss_order,adapt_rhs);
+                            }
                         }
                     }
+                    rhs.setcol(s,rhs_col);
                 }
-                rhs.setcol(s,rhs_col);
+                ++pb;
             }
         }
     }
 
     EITSourceMat::EITSourceMat(const Geometry& geo,const Sensors& electrodes,const unsigned gauss_order) {
+        const ScopedTimer timer("EITSourceMat");
         Matrix& mat = *this;
 
         //  A Matrix to be applied to the scalp-injected current to obtain the Source Term of the EIT foward problem.
@@ -146,30 +173,68 @@ namespace OpenMEEG {
         size_t n_sensors = electrodes.getNumberOfSensors();
 
         const double K = 1.0/(4*Pi);
+        const size_t size = geo.nb_parameters()-geo.nb_current_barrier_triangles();
 
-        //  transmat = a big SymMatrix of which mat = part of its transpose.
-        SymMatrix transmat(geo.nb_parameters());
-        transmat.set(0.0);
-        mat = Matrix((geo.nb_parameters()-geo.nb_current_barrier_triangles()), n_sensors);
+        mat = Matrix(size,n_sensors);
         mat.set(0.0);
 
-        for (const auto& mesh1 : geo.meshes())
-            if (mesh1.current_barrier())
-                for (const auto& mesh2 : geo.meshes()) {
-                    const int orientation = geo.oriented(mesh1,mesh2);
-                    if (orientation != 0){
-                        // D*_23 or D*_33
-                        operatorDstar(mesh2,mesh1,transmat,K*orientation,gauss_order);
-                        if (mesh1==mesh2) {
-                            // I_33
-                            operatorP1P0(mesh1,transmat,-0.5*orientation);
-                        } else {
-                            // S_23
-                            operatorS(mesh2,mesh1,transmat,geo.sigma_inv(mesh1,mesh2)*(-1.0*K*orientation),gauss_order);
-                        }
-                    }
+        //  Only the lines of the injection triangles are needed (they are current barrier triangles).
+        //  Instead of assembling the full [D*, S, P1P0] system and extracting these lines, each line is computed
+        //  directly, so that the cost is O(injection triangles x unknowns).
+
+        std::map<unsigned,unsigned> columns;
+        for (size_t ielec=0; ielec<n_sensors; ++ielec)
+            for (const auto& triangle : electrodes.getInjectionTriangles(ielec))
+                columns.insert({ triangle.index(), columns.size() });
+
+        std::vector<std::pair<const Triangle*,const Mesh*>> injection(columns.size(),{ nullptr, nullptr });
+        for (const auto& mesh : geo.meshes())
+            if (mesh.current_barrier())
+                for (const auto& triangle : mesh.triangles()) {
+                    const auto it = columns.find(triangle.index());
+                    if (it!=columns.end())
+                        injection[it->second] = { &triangle, &mesh };
                 }
 
+        Matrix lines(size,injection.size());
+        lines.set(0.0);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int j=0; j<static_cast<int>(injection.size()); ++j) {
+            const ThreadTimer busy;
+            const Triangle* triangle1 = injection[j].first;
+            const Mesh*     mesh1     = injection[j].second;
+            if (triangle1==nullptr)
+                continue;
+            double* const line = lines.data()+j*size;
+            for (const auto& mesh2 : geo.meshes()) {
+                const int orientation = geo.oriented(*mesh1,mesh2);
+                if (orientation==0)
+                    continue;
+
+                // D*_23 or D*_33
+
+                for (const auto& triangle2 : mesh2.triangles()) {
+                    const Vect3& D = Details::operatorD(*triangle1,triangle2,gauss_order);
+                    for (unsigned i=0; i<3; ++i)
+                        if (triangle2.vertex(i).index()<size)
+                            line[triangle2.vertex(i).index()] += K*orientation*D(i);
+                }
+
+                if (*mesh1==mesh2) {
+                    // I_33
+                    for (const auto& vertex : *triangle1)
+                        line[vertex->index()] += -0.5*orientation*Details::operatorP1P0(*triangle1,*vertex);
+                } else {
+                    // S_23
+                    const double coeff = geo.sigma_inv(*mesh1,mesh2)*(-1.0*K*orientation);
+                    for (const auto& triangle2 : mesh2.triangles())
+                        if (triangle2.index()<size)
+                            line[triangle2.index()] = Details::operatorS(analyticS(triangle2),*triangle1,gauss_order)*coeff;
+                }
+            }
+        }
+
         for ( size_t ielec = 0; ielec < n_sensors; ++ielec) {
             Triangles tris = electrodes.getInjectionTriangles(ielec);
             for ( Triangles::const_iterator tit = tris.begin(); tit != tris.end(); ++tit) {
@@ -179,8 +244,9 @@ namespace OpenMEEG {
                 if ( almost_equal(electrodes.getRadii()(ielec), 0.) ) {
                     inv_area = 1./tit->area();
                 }
-                for ( size_t i = 0; i < (geo.nb_parameters() - geo.nb_current_barrier_triangles()); ++i) {
-                    mat(i, ielec) += transmat(tit->index(), i) * inv_area;
+                const double* line = lines.data()+columns[tit->index()]*size;
+                for ( size_t i = 0; i < size; ++i) {
+                    mat(i, ielec) += line[i] * inv_area;
                 }
             }
         }
@@ -215,7 +281,7 @@ namespace OpenMEEG {
             const Domain& domain = (domain_name=="") ? geo.domain(r0) : geo.domain(domain_name);
             const double  cond   = domain.conductivity();
 
-            static analyticDipPot anaDP;
+            analyticDipPot anaDP;
             anaDP.init(q, r0);
             for (unsigned iPTS=0; iPTS<points_.size(); ++iPTS)
                 if (points_domain[iPTS]==&domain)
@@ -0,0 +1,201 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <assembly_checkpoint.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  File layout (native endianness): magic, version, key, matrix size, followed by records made of
+        //  block number, number of rows and columns, row indices, column indices, values (row major) and
+        //  a hash of the record.
+
+        const char     MagicTag[8]       = "OMCKPT";
+        const uint32_t CheckpointVersion = 1;
+
+        template <typename T>
+        bool read(std::istream& is,T& value) { return static_cast<bool>(is.read(reinterpret_cast<char*>(&value),sizeof(T))); }
+
+        template <typename T>
+        bool read(std::istream& is,std::vector<T>& values) {
+            return static_cast<bool>(is.read(reinterpret_cast<char*>(values.data()),values.size()*sizeof(T)));
+        }
+
+        template <typename T>
+        void write(std::ostream& os,const T& value) { os.write(reinterpret_cast<const char*>(&value),sizeof(T)); }
+
+        template <typename T>
+        void write(std::ostream& os,const std::vector<T>& values) {
+            os.write(reinterpret_cast<const char*>(values.data()),values.size()*sizeof(T));
+        }
+
+        template <typename T>
+        void hash(ContentHash& h,const std::vector<T>& values) { h.add(values.data(),values.size()*sizeof(T)); }
+
+        const std::streamoff HeaderSize = sizeof(MagicTag)+sizeof(uint32_t)+sizeof(ContentHash::Value)+sizeof(uint64_t);
+    }
+
+    AssemblyCheckpoint::AssemblyCheckpoint(const std::string& name,const ContentHash& hash,const size_t n,const bool resume):
+        filename(name),key(hash()),size(n)
+    {
+        const std::streamoff end = (resume) ? scan() : 0;
+        if (end!=0) {
+            //  Drop a partially written record (if any) before appending new ones.
+            std::error_code ec;
+            std::filesystem::resize_file(filename,end,ec);
+            os.open(filename,std::ios::binary|std::ios::app);
+            std::cout << "Resuming assembly from " << filename << ": " << done.size() << " block(s) already computed." << std::endl;
+        } else {
+            if (resume)
+                std::cout << "No valid checkpoint in " << filename << ", starting from scratch." << std::endl;
+            os.open(filename,std::ios::binary|std::ios::trunc);
+            os.write(MagicTag,sizeof(MagicTag));
+            write(os,CheckpointVersion);
+            write(os,key);
+            write(os,size);
+            os.flush();
+        }
+        if (!os)
+            std::cerr << "Warning: cannot write checkpoint file " << filename << "." << std::endl;
+    }
+
+    template <typename Function>
+    std::streamoff AssemblyCheckpoint::read_records(std::ifstream& is,Function f) const {
+        std::streamoff last = is.tellg();
+        while (true) {
+            uint32_t block;
+            uint64_t nrows,ncols;
+            if (!read(is,block) || !read(is,nrows) || !read(is,ncols) || nrows>size || ncols>size)
+                break;
+
+            Indices rows(nrows);
+            Indices cols(ncols);
+            std::vector<double> values(nrows*ncols);
+            ContentHash::Value value;
+            if (!read(is,rows) || !read(is,cols) || !read(is,values) || !read(is,value))
+                break;
+
+            ContentHash h;
+            h.add(block);
+            h.add(nrows);
+            h.add(ncols);
+            hash(h,rows);
+            hash(h,cols);
+            hash(h,values);
+            if (h()!=value)
+                break;
+
+            f(block,rows,cols,values);
+            last = is.tellg();
+        }
+        return last;
+    }
+
+    //  Validate the header and collect the completed blocks. Returns the end of the last valid record
+    //  (or 0 if the file cannot be used).
+
+    std::streamoff AssemblyCheckpoint::scan() {
+        std::ifstream is(filename,std::ios::binary);
+        if (!is.is_open())
+            return 0;
+
+        char magic[sizeof(MagicTag)];
+        uint32_t version;
+        ContentHash::Value filekey;
+        uint64_t filesize;
+        if (!is.read(magic,sizeof(magic)) || std::memcmp(magic,MagicTag,sizeof(MagicTag))!=0 ||
+            !read(is,version) || version!=CheckpointVersion || !read(is,filekey) || filekey!=key ||
+            !read(is,filesize) || filesize!=size)
+            return 0;
+
+        return read_records(is,[&](const unsigned block,const Indices&,const Indices&,const std::vector<double>&) {
+            done.insert(block);
+        });
+    }
+
+    void AssemblyCheckpoint::restore(SymMatrix& M) const {
+        if (done.empty())
+            return;
+        std::ifstream is(filename,std::ios::binary);
+        is.seekg(HeaderSize);
+        read_records(is,[&](const unsigned,const Indices& rows,const Indices& cols,const std::vector<double>& values) {
+            for (size_t i=0;i<rows.size();++i)
+                for (size_t j=0;j<cols.size();++j)
+                    M(rows[i],cols[j]) = values[i*cols.size()+j];
+        });
+    }
+
+    void AssemblyCheckpoint::save(const unsigned block,const Indices& rows,const Indices& cols,const SymMatrix& M) {
+        if (!os)
+            return;
+
+        std::vector<double> values(rows.size()*cols.size());
+        for (size_t i=0;i<rows.size();++i)
+            for (size_t j=0;j<cols.size();++j)
+                values[i*cols.size()+j] = M(rows[i],cols[j]);
+
+        const uint32_t b     = block;
+        const uint64_t nrows = rows.size();
+        const uint64_t ncols = cols.size();
+
+        ContentHash h;
+        h.add(b);
+        h.add(nrows);
+        h.add(ncols);
+        hash(h,rows);
+        hash(h,cols);
+        hash(h,values);
+
+        write(os,b);
+        write(os,nrows);
+        write(os,ncols);
+        write(os,rows);
+        write(os,cols);
+        write(os,values);
+        write(os,h());
+        os.flush();
+
+        done.insert(block);
+    }
+}
@@ -0,0 +1,163 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <filesystem>
+#include <future>
+
+#ifdef USE_OMP
+#include <omp.h>
+#endif
+
+#include <forward_pipeline.h>
+#include <assemble.h>
+#include <gain.h>
+#include <matrix_cache.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Each concurrent stage runs its own OpenMP loops. The head matrix dominates the assembly cost
+        //  and keeps all the threads of the caller, the other stages are much cheaper and run on a single
+        //  thread each: they overlap with the head matrix assembly while oversubscribing the processors
+        //  by a few threads at most. The limit only applies to the calling thread.
+
+        int available_threads() {
+        #ifdef USE_OMP
+            return omp_get_max_threads();
+        #else
+            return 1;
+        #endif
+        }
+
+        void limit_threads(const int nthreads) {
+        #ifdef USE_OMP
+            omp_set_num_threads(nthreads);
+        #endif
+        }
+    }
+
+    template <typename MATRIX>
+    void ForwardPipeline::spill(const MATRIX& M,const std::string& name) const {
+        if (options.spill_directory.empty())
+            return;
+        std::filesystem::create_directories(options.spill_directory);
+        M.save((std::filesystem::path(options.spill_directory)/(name+".bin")).string());
+    }
+
+    void ForwardPipeline::compute(const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids) {
+
+        //  All the assembly stages only depend on the geometry, the dipoles and the sensors and are run
+        //  concurrently (the operators do not rely on any shared state).
+
+        const int nthreads = available_threads();
+
+        auto head = std::async(std::launch::async,[&]() {
+            limit_threads(nthreads);
+            MatrixCache cache("HeadMat");
+            cache << geometry << options.gauss_order;
+            const SymMatrix& HM = cache.fetch<SymMatrix>([&]() { return HeadMat(geometry,options.gauss_order); });
+            spill(HM,"HeadMat");
+            return HM;
+        });
+
+        auto source = std::async(std::launch::async,[&]() {
+            limit_threads(1);
+            MatrixCache cache("DipSourceMat");
+            cache << geometry << dipoles << options.gauss_order << options.adapt_rhs << options.domain_name;
+            const Matrix& DSM = cache.fetch<Matrix>([&]() {
+                return DipSourceMat(geometry,dipoles,options.gauss_order,options.adapt_rhs,options.domain_name);
+            });
+            spill(DSM,"DipSourceMat");
+            return DSM;
+        });
+
+        std::future<SparseMatrix> head2eeg;
+        if (electrodes!=nullptr)
+            head2eeg = std::async(std::launch::async,[&]() {
+                limit_threads(1);
+                MatrixCache cache("Head2EEGMat");
+                cache << geometry << *electrodes;
+                const SparseMatrix& H2EM = cache.fetch<SparseMatrix>([&]() { return Head2EEGMat(geometry,*electrodes); });
+                spill(H2EM,"Head2EEGMat");
+                return H2EM;
+            });
+
+        std::future<Matrix> head2meg;
+        std::future<Matrix> source2meg;
+        if (squids!=nullptr) {
+            head2meg = std::async(std::launch::async,[&]() {
+                limit_threads(1);
+                MatrixCache cache("Head2MEGMat");
+                cache << geometry << *squids;
+                const Matrix& H2MM = cache.fetch<Matrix>([&]() { return Head2MEGMat(geometry,*squids); });
+                spill(H2MM,"Head2MEGMat");
+                return H2MM;
+            });
+            source2meg = std::async(std::launch::async,[&]() {
+                limit_threads(1);
+                const DipSource2MEGMat DS2MM(dipoles,*squids);
+                spill(DS2MM,"DipSource2MEGMat");
+                return Matrix(DS2MM);
+            });
+        }
+
+        //  Stack the sensor matrices so that the head matrix is factorized only once.
+
+        const SparseMatrix& H2EM = (electrodes!=nullptr) ? head2eeg.get() : SparseMatrix();
+        const Matrix&       H2MM = (squids!=nullptr)     ? head2meg.get() : Matrix();
+        const SymMatrix&    HM   = head.get();
+
+        const unsigned neeg = H2EM.nlin();
+        const unsigned nmeg = H2MM.nlin();
+        Matrix RHS(neeg+nmeg,HM.nlin());
+        for (unsigned i=0; i<neeg; ++i)
+            RHS.setlin(i,H2EM.getlin(i));
+        for (unsigned i=0; i<nmeg; ++i)
+            RHS.setlin(neeg+i,H2MM.getlin(i));
+
+        const Matrix& X = linsolve(HM,RHS,options.mixed_precision);
+
+        const Matrix& DSM = source.get();
+        const Matrix& G   = X*DSM;
+
+        EEGleadfield = (neeg!=0) ? G.submat(0,neeg,0,G.ncol()) : Matrix();
+        MEGleadfield = (nmeg!=0) ? source2meg.get()+G.submat(neeg,nmeg,0,G.ncol()) : Matrix();
+    }
+}
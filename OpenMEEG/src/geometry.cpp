@@ -227,6 +227,7 @@ namespace OpenMEEG {
         for (const auto& desc : mesh_list) {
             const std::string& name = desc.first;
             const std::string& path = desc.second;
+            input_files.push_back(path);
             MeshIO* io = MeshIO::create(path);
             io->open();
             io->load_points(*this); 
@@ -269,6 +270,7 @@ namespace OpenMEEG {
             std::cerr << "Could not read the conductivity file: " << filename << std::endl;
             exit(1);
         }
+        input_files.push_back(filename);
         conductivities = true;
     }
 
@@ -0,0 +1,411 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <geometry.h>
+#include <content_hash.h>
+#include <OpenMEEGConfigure.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Binary cache file layout (native endianness, the cache is meant to stay on one machine):
+        //      magic, format version, list of input files with their content hashes,
+        //      vertices, meshes (vertex references, triangles with indices/areas/normals, flags),
+        //      domains (conductivity, boundaries with their interfaces), and the finalization results
+        //      (outermost domain, nesting, indices, current barriers, isolated parts, mesh pairs).
+
+        const char     MagicTag[8]   = { 'O', 'M', 'G', 'E', 'O', 'M', '\0', '\0' };
+        const uint32_t CacheVersion  = 1;
+        const uint32_t NoIndex       = static_cast<uint32_t>(-1);
+
+        std::string default_cache_directory() {
+            const char* dir = std::getenv("OPENMEEG_CACHE_DIR");
+            return (dir==nullptr) ? "" : dir;
+        }
+
+        std::string absolute(const std::string& name) {
+            std::error_code ec;
+            const std::filesystem::path& path = std::filesystem::absolute(name,ec);
+            return (ec) ? name : path.lexically_normal().string();
+        }
+
+        class Writer {
+        public:
+
+            Writer(std::ostream& s): os(s) { }
+
+            template <typename T>
+            void operator()(const T& value) { os.write(reinterpret_cast<const char*>(&value),sizeof(T)); }
+
+            void operator()(const std::string& str) {
+                (*this)(static_cast<uint64_t>(str.size()));
+                os.write(str.data(),str.size());
+            }
+
+            void operator()(const Vect3& v) {
+                (*this)(v.x());
+                (*this)(v.y());
+                (*this)(v.z());
+            }
+
+        private:
+
+            std::ostream& os;
+        };
+
+        class Reader {
+        public:
+
+            Reader(std::istream& s): is(s) { }
+
+            template <typename T>
+            T get() {
+                T value;
+                read(value);
+                return value;
+            }
+
+            template <typename T>
+            void read(T& value) {
+                if (!is.read(reinterpret_cast<char*>(&value),sizeof(T)))
+                    throw std::runtime_error("Truncated geometry cache");
+            }
+
+            void read(std::string& str) {
+                str.resize(get<uint64_t>());
+                if (!is.read(&str[0],str.size()))
+                    throw std::runtime_error("Truncated geometry cache");
+            }
+
+            void read(Vect3& v) {
+                read(v.x());
+                read(v.y());
+                read(v.z());
+            }
+
+            //  Read an index and check that it is lower than n.
+
+            uint32_t index(const size_t n) {
+                const uint32_t ind = get<uint32_t>();
+                if (ind>=n)
+                    throw std::runtime_error("Corrupted geometry cache");
+                return ind;
+            }
+
+        private:
+
+            std::istream& is;
+        };
+    }
+
+    std::string Geometry::cache_directory = default_cache_directory();
+
+    std::string Geometry::cache_file(const std::string& geomFileName,const std::string& condFileName,const bool OLD_ORDERING) {
+        if (cache_directory.empty())
+            return "";
+
+        ContentHash key;
+        key.add(std::string(version));
+        key.add(CacheVersion);
+        key.add(absolute(geomFileName));
+        key.add(condFileName.empty() ? condFileName : absolute(condFileName));
+        key.add(OLD_ORDERING);
+        return (std::filesystem::path(cache_directory)/("geometry-"+key.hex()+".omgeom")).string();
+    }
+
+    void Geometry::write_cache(const std::string& filename) const {
+        if (filename.empty())
+            return;
+
+        //  Write to a temporary file which is then renamed, so that concurrent commands never see a partial cache.
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(filename).parent_path(),ec);
+        const std::string& tmpname = filename+"."+std::to_string(std::random_device()())+".tmp";
+        std::ofstream os(tmpname,std::ios::binary);
+        if (!os.is_open())
+            return;
+
+        Writer write(os);
+
+        write(MagicTag);
+        write(CacheVersion);
+
+        write(static_cast<uint64_t>(input_files.size()));
+        for (const auto& name : input_files) {
+            ContentHash hash;
+            if (!hash.add_file(name)) {
+                os.close();
+                std::remove(tmpname.c_str());
+                return;
+            }
+            write(absolute(name));
+            write(hash());
+        }
+
+        const Vertex* vertex0 = vertices().data();
+        const Mesh*   mesh0   = meshes().data();
+
+        write(static_cast<uint64_t>(vertices().size()));
+        for (const auto& vertex : vertices()) {
+            write(static_cast<const Vect3&>(vertex));
+            write(vertex.index());
+        }
+
+        write(static_cast<uint64_t>(meshes().size()));
+        for (const auto& mesh : meshes()) {
+            write(mesh.name());
+            write(mesh.outermost());
+            write(mesh.current_barrier());
+            write(mesh.isolated());
+            write(static_cast<uint64_t>(mesh.vertices().size()));
+            for (const auto& vertex : mesh.vertices())
+                write(static_cast<uint32_t>(vertex-vertex0));
+            write(static_cast<uint64_t>(mesh.triangles().size()));
+            for (const auto& triangle : mesh.triangles()) {
+                for (unsigned i=0;i<3;++i)
+                    write(static_cast<uint32_t>(&triangle.vertex(i)-vertex0));
+                write(triangle.index());
+                write(triangle.area());
+                write(triangle.normal());
+            }
+        }
+
+        write(static_cast<uint64_t>(domains().size()));
+        for (const auto& domain : domains()) {
+            write(domain.name());
+            write(domain.conductivity());
+            write(static_cast<uint64_t>(domain.boundaries().size()));
+            for (const auto& boundary : domain.boundaries()) {
+                const Interface& interface = boundary.interface();
+                write(boundary.inside());
+                write(interface.name());
+                write(interface.outermost());
+                write(static_cast<uint64_t>(interface.oriented_meshes().size()));
+                for (const auto& omesh : interface.oriented_meshes()) {
+                    write(static_cast<uint32_t>(&omesh.mesh()-mesh0));
+                    write(static_cast<int32_t>(omesh.orientation()));
+                }
+            }
+        }
+
+        write((outer_domain==nullptr) ? NoIndex : static_cast<uint32_t>(outer_domain-domains().data()));
+        write(nested);
+        write(conductivities);
+        write(static_cast<uint64_t>(num_params));
+        write(static_cast<uint64_t>(nb_current_barrier_triangles_));
+
+        write(static_cast<uint64_t>(invalid_vertices_.size()));
+        for (const auto& vertex : invalid_vertices_) {
+            write(static_cast<const Vect3&>(vertex));
+            write(vertex.index());
+        }
+
+        write(static_cast<uint64_t>(independant_parts.size()));
+        for (const auto& part : independant_parts) {
+            write(static_cast<uint64_t>(part.size()));
+            for (const auto& meshptr : part)
+                write(static_cast<uint32_t>(meshptr-mesh0));
+        }
+
+        write(static_cast<uint64_t>(meshpairs.size()));
+        for (const auto& pair : meshpairs) {
+            write(static_cast<uint32_t>(&pair(0)-mesh0));
+            write(static_cast<uint32_t>(&pair(1)-mesh0));
+            write(static_cast<int32_t>(pair.relative_orientation()));
+        }
+
+        os.close();
+        if (!os || std::rename(tmpname.c_str(),filename.c_str())!=0)
+            std::remove(tmpname.c_str());
+    }
+
+    bool Geometry::read_cache(const std::string& filename) {
+        if (filename.empty())
+            return false;
+
+        std::ifstream is(filename,std::ios::binary);
+        if (!is.is_open())
+            return false;
+
+        //  On any failure, the partially restored state is dropped so that the geometry can be read normally.
+
+        const auto fail = [this]() {
+            clear();
+            input_files.clear();
+            return false;
+        };
+
+        try {
+            Reader read(is);
+
+            char magic[sizeof(MagicTag)];
+            read.read(magic);
+            if (std::memcmp(magic,MagicTag,sizeof(MagicTag))!=0 || read.get<uint32_t>()!=CacheVersion)
+                return fail();
+
+            //  Check that none of the inputs has changed.
+
+            const uint64_t ninputs = read.get<uint64_t>();
+            for (uint64_t i=0;i<ninputs;++i) {
+                std::string name;
+                read.read(name);
+                ContentHash hash;
+                if (!hash.add_file(name) || hash()!=read.get<ContentHash::Value>())
+                    return fail();
+                input_files.push_back(name);
+            }
+
+            //  Vertices are never reallocated after this point, so that pointers to them stay valid.
+
+            vertices().resize(read.get<uint64_t>());
+            for (auto& vertex : vertices()) {
+                read.read(static_cast<Vect3&>(vertex));
+                read.read(vertex.index());
+            }
+
+            Vertex* vertex0 = vertices().data();
+            const size_t nvertices = vertices().size();
+
+            //  Mesh flags are restored at the end, as rebuilding the interfaces may change them.
+
+            struct Flags { bool outermost, current_barrier, isolated; };
+
+            const uint64_t nmeshes = read.get<uint64_t>();
+            std::vector<Flags> flags(nmeshes);
+            meshes().reserve(nmeshes);
+            for (uint64_t m=0;m<nmeshes;++m) {
+                std::string name;
+                read.read(name);
+                Mesh& mesh = add_mesh(name);
+                read.read(flags[m].outermost);
+                read.read(flags[m].current_barrier);
+                read.read(flags[m].isolated);
+                mesh.vertices().resize(read.get<uint64_t>());
+                for (auto& vertex : mesh.vertices())
+                    vertex = vertex0+read.index(nvertices);
+                mesh.triangles().resize(read.get<uint64_t>());
+                for (auto& triangle : mesh.triangles()) {
+                    Vertex* pts[3];
+                    for (unsigned i=0;i<3;++i)
+                        pts[i] = vertex0+read.index(nvertices);
+                    triangle = Triangle(pts);
+                    read.read(triangle.index());
+                    read.read(triangle.area());
+                    read.read(triangle.normal());
+                }
+                mesh.make_adjacencies();
+            }
+
+            Mesh* mesh0 = meshes().data();
+
+            domains().resize(read.get<uint64_t>());
+            for (auto& domain : domains()) {
+                read.read(domain.name());
+                domain.set_conductivity(read.get<double>());
+                const uint64_t nboundaries = read.get<uint64_t>();
+                for (uint64_t b=0;b<nboundaries;++b) {
+                    const SimpleDomain::Side side = (read.get<bool>()) ? SimpleDomain::Inside : SimpleDomain::Outside;
+                    std::string name;
+                    read.read(name);
+                    Interface interface(name);
+                    const bool outermost = read.get<bool>();
+                    const uint64_t noriented = read.get<uint64_t>();
+                    for (uint64_t i=0;i<noriented;++i) {
+                        Mesh& mesh = mesh0[read.index(nmeshes)];
+                        const OrientedMesh::Orientation orientation = (read.get<int32_t>()==OrientedMesh::Normal) ? OrientedMesh::Normal : OrientedMesh::Opposite;
+                        interface.oriented_meshes().push_back(OrientedMesh(mesh,orientation));
+                    }
+                    if (outermost)
+                        interface.set_to_outermost();
+                    domain.boundaries().push_back(SimpleDomain(interface,side));
+                }
+            }
+
+            const uint32_t outer = read.get<uint32_t>();
+            outer_domain = (outer==NoIndex) ? nullptr : &domains().at(outer);
+            read.read(nested);
+            read.read(conductivities);
+            num_params = read.get<uint64_t>();
+            nb_current_barrier_triangles_ = read.get<uint64_t>();
+
+            const uint64_t ninvalid = read.get<uint64_t>();
+            for (uint64_t i=0;i<ninvalid;++i) {
+                Vertex vertex;
+                read.read(static_cast<Vect3&>(vertex));
+                read.read(vertex.index());
+                invalid_vertices_.insert(vertex);
+            }
+
+            independant_parts.resize(read.get<uint64_t>());
+            for (auto& part : independant_parts) {
+                part.resize(read.get<uint64_t>());
+                for (auto& meshptr : part)
+                    meshptr = mesh0+read.index(nmeshes);
+            }
+
+            const uint64_t npairs = read.get<uint64_t>();
+            for (uint64_t i=0;i<npairs;++i) {
+                const Mesh& mesh1 = mesh0[read.index(nmeshes)];
+                const Mesh& mesh2 = mesh0[read.index(nmeshes)];
+                meshpairs.push_back(MeshPair(mesh1,mesh2,read.get<int32_t>()));
+            }
+
+            for (uint64_t m=0;m<nmeshes;++m) {
+                mesh0[m].outermost()       = flags[m].outermost;
+                mesh0[m].current_barrier() = flags[m].current_barrier;
+                mesh0[m].isolated()        = flags[m].isolated;
+            }
+        } catch (const std::exception&) {
+            return fail();
+        }
+
+        return true;
+    }
+}
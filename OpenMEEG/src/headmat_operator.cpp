@@ -0,0 +1,352 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <set>
+
+#include <om_common.h>
+#include <operators.h>
+#include <headmat_operator.h>
+
+#include <constants.h>
+
+namespace OpenMEEG {
+
+    namespace Details {
+
+        // Values of the S operator (between triangles of m1 and m2) as read by Details::operatorN.
+        // For current barriers, indices are local to the meshes and the value is divided by the areas,
+        // otherwise indices are global (as for the S block of HeadMat).
+
+        class SOperator {
+        public:
+
+            SOperator(const Mesh& m1,const Mesh& m2,const unsigned order): mesh1(m1),mesh2(m2),gauss_order(order) { }
+
+            double operator()(const unsigned i,const unsigned j) const {
+                const bool local = mesh1.current_barrier() || mesh2.current_barrier();
+                const unsigned ind1 = (local) ? i : i-mesh1.triangles().front().index();
+                const unsigned ind2 = (local) ? j : j-mesh2.triangles().front().index();
+                const Triangle& T1 = mesh1.triangles()[ind1];
+                const Triangle& T2 = mesh2.triangles()[ind2];
+                const double value = (&mesh1==&mesh2 && ind2<ind1) ? operatorS(analyticS(T2),T1,gauss_order) : operatorS(analyticS(T1),T2,gauss_order);
+                return (local) ? value/(T1.area()*T2.area()) : value;
+            }
+
+        private:
+
+            const Mesh&    mesh1;
+            const Mesh&    mesh2;
+            const unsigned gauss_order;
+        };
+
+        // Gradient of the P1 function associated to the vertex V of triangle T (up to a rotation),
+        // as used in Details::operatorN.
+
+        inline Vect3 edge_vector(const Triangle& T,const Vertex& V) {
+            const Edge& edge = T.edge(V);
+            return (edge.vertex(0)-edge.vertex(1))/T.area();
+        }
+    }
+
+    HeadMatOperator::HeadMatOperator(const Geometry& geo,const unsigned order,const double near_field):
+        LinOp(geo.nb_parameters()-geo.nb_current_barrier_triangles(),geo.nb_parameters()-geo.nb_current_barrier_triangles(),SYMMETRIC,2),
+        gauss_order(order)
+    {
+        // Same block structure as in Details::HeadMatrix.
+
+        for (const auto& mp : geo.communicating_mesh_pairs()) {
+            const Mesh& mesh1 = mp(0);
+            const Mesh& mesh2 = mp(1);
+            const double factor = mp.relative_orientation()*K;
+
+            Block block;
+            block.mesh1  = &mesh1;
+            block.mesh2  = &mesh2;
+            block.S      = !mesh1.current_barrier() && !mesh2.current_barrier();
+            block.D      = !mesh1.current_barrier();
+            block.Dstar  = &mesh1!=&mesh2 && !mesh2.current_barrier();
+            block.Scoeff = (block.S) ? factor*geo.sigma_inv(mesh1,mesh2) : 0.0;
+            block.Dcoeff = -factor*geo.indicator(mesh1,mesh2);
+            block.Ncoeff = factor*geo.sigma(mesh1,mesh2);
+            if (near_field>0.0)
+                cache_near_field(block,near_field);
+            blocks.push_back(block);
+        }
+
+        compute_diagonal(geo);
+    }
+
+    void HeadMatOperator::cache_near_field(Block& block,const double near_field) {
+        const Triangles& triangles1 = block.mesh1->triangles();
+        const Triangles& triangles2 = block.mesh2->triangles();
+        block.near.resize(triangles1.size());
+
+        #pragma omp parallel for
+        #ifdef OPENMP_UNSIGNED
+        for (unsigned i1=0;i1<triangles1.size();++i1) {
+        #else
+        for (int i1=0;i1<static_cast<int>(triangles1.size());++i1) {
+        #endif
+            const Triangle& T1 = triangles1[i1];
+            const analyticS analyS(T1);
+            for (unsigned i2=0;i2<triangles2.size();++i2) {
+                const Triangle& T2 = triangles2[i2];
+                const double dist = (T1.center()-T2.center()).norm();
+                if (dist>=near_field*(sqrt(T1.area())+sqrt(T2.area())))
+                    continue;
+                Interaction interaction;
+                interaction.index = i2;
+                interaction.S     = Details::operatorS(analyS,T2,gauss_order);
+                interaction.D     = (block.D)     ? Details::operatorD(T1,T2,gauss_order) : Vect3(0.0);
+                interaction.Dstar = (block.Dstar) ? Details::operatorD(T2,T1,gauss_order) : Vect3(0.0);
+                block.near[i1].push_back(interaction);
+            }
+        }
+    }
+
+    void HeadMatOperator::compute_diagonal(const Geometry& geo) {
+        diag = Vector(nlin());
+        diag.set(0.0);
+        for (const auto& block : blocks) {
+            const Mesh& mesh1 = *block.mesh1;
+            const Mesh& mesh2 = *block.mesh2;
+            const Details::SOperator S(mesh1,mesh2,gauss_order);
+            if (&mesh1==&mesh2) {
+                if (block.S)
+                    for (const auto& triangle : mesh1.triangles())
+                        diag(triangle.index()) += block.Scoeff*Details::operatorS(analyticS(triangle),triangle,gauss_order);
+                for (const auto& vertex : mesh1.vertices())
+                    diag(vertex->index()) += block.Ncoeff*Details::operatorN(*vertex,*vertex,mesh1,mesh1,S);
+            } else {
+                const std::set<const Vertex*> vertices2(mesh2.vertices().begin(),mesh2.vertices().end());
+                for (const auto& vertex : mesh1.vertices())
+                    if (vertices2.count(vertex)!=0)
+                        diag(vertex->index()) += block.Ncoeff*Details::operatorN(*vertex,*vertex,mesh1,mesh2,S);
+            }
+        }
+
+        // Deflation (see Details::deflate): the coefficient depends on the non-deflated diagonal.
+
+        for (const auto& part : geo.isolated_parts()) {
+            unsigned nb_vertices = 0;
+            unsigned i_first = 0;
+            for (const auto& meshptr : part)
+                if (meshptr->outermost()) {
+                    nb_vertices += meshptr->vertices().size();
+                    if (i_first==0)
+                        i_first = meshptr->vertices().front()->index();
+                }
+            const double coef = diag(i_first)/nb_vertices;
+            for (const auto& meshptr : part)
+                if (meshptr->outermost())
+                    deflations.push_back({ meshptr, coef });
+        }
+
+        for (const auto& deflation : deflations)
+            for (const auto& vertex : deflation.mesh->vertices())
+                diag(vertex->index()) += deflation.coeff;
+    }
+
+    size_t HeadMatOperator::nb_cached_interactions() const {
+        size_t n = 0;
+        for (const auto& block : blocks)
+            for (const auto& row : block.near)
+                n += row.size();
+        return n;
+    }
+
+    void HeadMatOperator::info() const {
+        std::cout << "HeadMatOperator: " << nlin() << 'x' << ncol() << " (matrix-free), "
+                  << blocks.size() << " blocks, " << nb_cached_interactions() << " cached near-field interactions." << std::endl;
+    }
+
+    Vector HeadMatOperator::operator*(const Vector& x) const {
+        om_assert(x.size()==ncol());
+        Vector y(nlin());
+        apply(x.data(),y.data(),1);
+        return y;
+    }
+
+    Matrix HeadMatOperator::operator*(const Matrix& X) const {
+        om_assert(X.nlin()==ncol());
+        Matrix Y(nlin(),X.ncol());
+        apply(X.data(),Y.data(),X.ncol());
+        return Y;
+    }
+
+    void HeadMatOperator::apply(const double* x,double* y,const unsigned ncols) const {
+        const size_t N = nlin();
+        std::fill(y,y+N*ncols,0.0);
+
+        for (const auto& block : blocks)
+            apply(block,x,y,ncols);
+
+        for (const auto& deflation : deflations)
+            for (unsigned c=0;c<ncols;++c) {
+                double sum = 0.0;
+                for (const auto& vertex : deflation.mesh->vertices())
+                    sum += x[vertex->index()+c*N];
+                for (const auto& vertex : deflation.mesh->vertices())
+                    y[vertex->index()+c*N] += deflation.coeff*sum;
+            }
+    }
+
+    void HeadMatOperator::apply(const Block& block,const double* x,double* y,const unsigned ncols) const {
+
+        // S and D (D*) blocks are applied directly (both the block and its transpose since HeadMat is symmetric).
+        // The N block is factored through the S values of the triangle pairs:
+        //     N(v1,v2) = -1/4 sum_{T1 ∋ v1, T2 ∋ v2} S(T1,T2) <CB1/|T1|,CB2/|T2|>
+        // so that W(T) = sum_{v ∈ T} CB/|T| x(v) is accumulated as Z(T1) = sum_{T2} S(T1,T2) W(T2).
+        // Shared vertices (factor 1/2 in Details::operatorN) are correctly handled as the symmetric
+        // contribution is accumulated twice.
+
+        const size_t N = nlin();
+        const Mesh& mesh1 = *block.mesh1;
+        const Mesh& mesh2 = *block.mesh2;
+        const bool same_mesh = &mesh1==&mesh2;
+        const Triangles& triangles1 = mesh1.triangles();
+        const Triangles& triangles2 = mesh2.triangles();
+        const size_t ld = 3*ncols;
+
+        auto computeW = [&](const Triangles& triangles) {
+            std::vector<double> W(triangles.size()*ld,0.0);
+            for (unsigned i=0;i<triangles.size();++i) {
+                const Triangle& T = triangles[i];
+                for (const auto& vertex : T) {
+                    const Vect3& CB = Details::edge_vector(T,*vertex);
+                    for (unsigned c=0;c<ncols;++c)
+                        for (unsigned k=0;k<3;++k)
+                            W[i*ld+3*c+k] += CB(k)*x[vertex->index()+c*N];
+                }
+            }
+            return W;
+        };
+
+        const std::vector<double>& W1 = computeW(triangles1);
+        const std::vector<double>& W2 = (same_mesh) ? W1 : computeW(triangles2);
+
+        std::vector<double> Z1(triangles1.size()*ld,0.0);
+        std::vector<double> Z2((same_mesh) ? 0 : triangles2.size()*ld,0.0);
+
+        #pragma omp parallel
+        {
+            std::vector<double> yl(N*ncols,0.0);
+            std::vector<double> Z1l(Z1.size(),0.0);
+            std::vector<double> Z2l(Z2.size(),0.0);
+            std::vector<double>& Z2r = (same_mesh) ? Z1l : Z2l;
+
+            auto add = [&](const unsigned i,const unsigned j,const double value) {
+                for (unsigned c=0;c<ncols;++c) {
+                    yl[i+c*N] += value*x[j+c*N];
+                    if (i!=j)
+                        yl[j+c*N] += value*x[i+c*N];
+                }
+            };
+
+            #pragma omp for schedule(dynamic)
+            #ifdef OPENMP_UNSIGNED
+            for (unsigned i1=0;i1<triangles1.size();++i1) {
+            #else
+            for (int i1=0;i1<static_cast<int>(triangles1.size());++i1) {
+            #endif
+                const Triangle& T1 = triangles1[i1];
+                const analyticS analyS(T1);
+                const std::vector<Interaction>* near = (block.near.empty()) ? nullptr : &block.near[i1];
+                auto nit = (near) ? near->begin() : std::vector<Interaction>::const_iterator();
+                for (unsigned i2=0;i2<triangles2.size();++i2) {
+                    const Triangle& T2 = triangles2[i2];
+                    const bool cached = near && nit!=near->end() && nit->index==i2;
+                    const bool upper  = !same_mesh || i2>=static_cast<unsigned>(i1);
+
+                    if (upper) {
+                        const double S = (cached) ? nit->S : Details::operatorS(analyS,T2,gauss_order);
+                        if (block.S)
+                            add(T1.index(),T2.index(),block.Scoeff*S);
+                        for (unsigned l=0;l<ld;++l)
+                            Z1l[i1*ld+l] += S*W2[i2*ld+l];
+                        if (!same_mesh || i2!=static_cast<unsigned>(i1))
+                            for (unsigned l=0;l<ld;++l)
+                                Z2r[i2*ld+l] += S*W1[i1*ld+l];
+                    }
+
+                    if (block.D) {
+                        const Vect3& D = (cached) ? nit->D : Details::operatorD(T1,T2,gauss_order);
+                        for (unsigned k=0;k<3;++k)
+                            add(T1.index(),T2.vertex(k).index(),block.Dcoeff*D(k));
+                    }
+
+                    if (block.Dstar) {
+                        const Vect3& D = (cached) ? nit->Dstar : Details::operatorD(T2,T1,gauss_order);
+                        for (unsigned k=0;k<3;++k)
+                            add(T2.index(),T1.vertex(k).index(),block.Dcoeff*D(k));
+                    }
+
+                    if (cached)
+                        ++nit;
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (size_t i=0;i<yl.size();++i)
+                    y[i] += yl[i];
+                for (size_t i=0;i<Z1.size();++i)
+                    Z1[i] += Z1l[i];
+                for (size_t i=0;i<Z2.size();++i)
+                    Z2[i] += Z2l[i];
+            }
+        }
+
+        auto applyN = [&](const Triangles& triangles,const std::vector<double>& Z) {
+            const double coeff = -0.25*block.Ncoeff;
+            for (unsigned i=0;i<triangles.size();++i) {
+                const Triangle& T = triangles[i];
+                for (const auto& vertex : T) {
+                    const Vect3& CB = Details::edge_vector(T,*vertex);
+                    for (unsigned c=0;c<ncols;++c)
+                        y[vertex->index()+c*N] += coeff*(CB(0)*Z[i*ld+3*c]+CB(1)*Z[i*ld+3*c+1]+CB(2)*Z[i*ld+3*c+2]);
+                }
+            }
+        };
+
+        applyN(triangles1,Z1);
+        if (!same_mesh)
+            applyN(triangles2,Z2);
+    }
+}
@@ -0,0 +1,245 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include <instrumentation.h>
+#include <OpenMEEGConfigure.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        struct TimerStats {
+            uint64_t calls    = 0;
+            double   seconds  = 0.0;
+            uint64_t peak_rss = 0;
+        };
+
+        //  Thread statistics are only written by their thread, and are read when reporting.
+
+        struct ThreadStats {
+            double   busy = 0.0;
+            uint64_t counters[Profiler::NbCounters] = { };
+        };
+
+        struct State {
+            std::mutex                                mutex;
+            std::string                               command;
+            Profiler::Clock::time_point               start;
+            std::map<std::string,TimerStats>          timers;
+            std::vector<std::unique_ptr<ThreadStats>> threads;
+        };
+
+        State& state() {
+            static State s;
+            return s;
+        }
+
+        ThreadStats& thread_stats() {
+            thread_local ThreadStats* stats = nullptr;
+            if (stats==nullptr) {
+                State& s = state();
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.threads.push_back(std::make_unique<ThreadStats>());
+                stats = s.threads.back().get();
+            }
+            return *stats;
+        }
+
+        const char* CounterNames[Profiler::NbCounters] = { "kernel_evaluations", "adaptive_refinements" };
+
+        std::string quoted(const std::string& str) {
+            std::ostringstream oss;
+            oss << '"';
+            for (const char c : str)
+                switch (c) {
+                    case '"':  oss << "\\\""; break;
+                    case '\\': oss << "\\\\"; break;
+                    case '\n': oss << "\\n";  break;
+                    case '\t': oss << "\\t";  break;
+                    default:   oss << c;
+                }
+            oss << '"';
+            return oss.str();
+        }
+    }
+
+    bool Profiler::active = false;
+
+    void Profiler::start() {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.start = Clock::now();
+        s.timers.clear();
+        for (auto& thread : s.threads)
+            *thread = ThreadStats();
+        active = true;
+    }
+
+    void Profiler::increment(const Counter counter,const uint64_t n) { thread_stats().counters[counter] += n; }
+
+    void Profiler::add_busy_time(const double seconds) { thread_stats().busy += seconds; }
+
+    void Profiler::add_time(const std::string& timer,const double seconds) {
+        const uint64_t rss = peak_rss();
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        TimerStats& stats = s.timers[timer];
+        ++stats.calls;
+        stats.seconds  += seconds;
+        stats.peak_rss  = std::max(stats.peak_rss,rss);
+    }
+
+    uint64_t Profiler::peak_rss() {
+    #if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF,&usage)!=0)
+            return 0;
+        #ifdef __APPLE__
+        return usage.ru_maxrss/1024; // bytes on macOS
+        #else
+        return usage.ru_maxrss;
+        #endif
+    #else
+        return 0;
+    #endif
+    }
+
+    void Profiler::report(std::ostream& os) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const double wall_time = std::chrono::duration<double>(Clock::now()-s.start).count();
+
+        uint64_t totals[NbCounters] = { };
+        std::vector<const ThreadStats*> workers;
+        for (const auto& thread : s.threads) {
+            for (unsigned i=0; i<NbCounters; ++i)
+                totals[i] += thread->counters[i];
+            if (thread->busy>0.0)
+                workers.push_back(thread.get());
+        }
+
+        os << std::setprecision(9) << "{" << std::endl
+           << "    \"command\": " << quoted(s.command) << ',' << std::endl
+           << "    \"version\": " << quoted(version) << ',' << std::endl
+           << "    \"wall_time\": " << wall_time << ',' << std::endl
+           << "    \"peak_rss_kb\": " << peak_rss() << ',' << std::endl;
+
+        os << "    \"timers\": {";
+        const char* separator = "";
+        for (const auto& timer : s.timers) {
+            os << separator << std::endl << "        " << quoted(timer.first) << ": { \"calls\": " << timer.second.calls
+               << ", \"seconds\": " << timer.second.seconds << ", \"peak_rss_kb\": " << timer.second.peak_rss << " }";
+            separator = ",";
+        }
+        os << std::endl << "    }," << std::endl;
+
+        os << "    \"counters\": {";
+        for (unsigned i=0; i<NbCounters; ++i)
+            os << ((i==0) ? "" : ",") << std::endl << "        " << quoted(CounterNames[i]) << ": " << totals[i];
+        os << std::endl << "    }," << std::endl;
+
+        //  Busy time of the threads which took part to parallel loops. The imbalance is the ratio
+        //  between the maximum and the mean busy times (1 for a perfectly balanced load).
+
+        double max_busy = 0.0;
+        double sum_busy = 0.0;
+        os << "    \"threads\": [";
+        separator = "";
+        for (const auto& worker : workers) {
+            os << separator << std::endl << "        { \"busy_time\": " << worker->busy;
+            for (unsigned i=0; i<NbCounters; ++i)
+                os << ", " << quoted(CounterNames[i]) << ": " << worker->counters[i];
+            os << " }";
+            separator = ",";
+            max_busy  = std::max(max_busy,worker->busy);
+            sum_busy += worker->busy;
+        }
+        os << ((workers.empty()) ? "" : "\n    ") << "]," << std::endl
+           << "    \"load_imbalance\": " << ((sum_busy>0.0) ? max_busy*workers.size()/sum_busy : 1.0) << std::endl
+           << "}" << std::endl;
+    }
+
+    bool Profiler::save(const std::string& filename) {
+        std::ofstream ofs(filename);
+        if (!ofs.is_open())
+            return false;
+        report(ofs);
+        return static_cast<bool>(ofs);
+    }
+
+    std::string Profiler::option(int& argc,char** argv) {
+        for (int i=1; i<argc; ++i)
+            if (!strcmp(argv[i],"--profile")) {
+                if (i+1>=argc) {
+                    std::cerr << "Option --profile expects a report file name." << std::endl;
+                    return "";
+                }
+                const std::string filename = argv[i+1];
+
+                std::string command = argv[0];
+                for (int j=1; j<argc; ++j)
+                    if (j!=i && j!=i+1)
+                        command += std::string(" ")+argv[j];
+
+                std::copy(argv+i+2,argv+argc,argv+i);
+                argc -= 2;
+
+                start();
+                state().command = command;
+                return filename;
+            }
+        return "";
+    }
+}
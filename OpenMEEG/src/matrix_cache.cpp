@@ -0,0 +1,242 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include <matrix_cache.h>
+#include <OpenMEEGConfigure.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Bump this whenever a change in the assembly code alters the computed matrices.
+
+        const unsigned CacheVersion = 2;
+        const char     Extension[]  = ".omb";
+
+        std::string default_directory() {
+            const char* dir = std::getenv("OPENMEEG_CACHE_DIR");
+            return (dir==nullptr) ? "" : dir;
+        }
+
+        std::uintmax_t default_max_size() {
+            const char* size = std::getenv("OPENMEEG_CACHE_SIZE");
+            return (size==nullptr) ? 0 : static_cast<std::uintmax_t>(std::strtoull(size,nullptr,10))<<20;
+        }
+
+        void touch(const std::filesystem::path& path) {
+            std::error_code ec;
+            std::filesystem::last_write_time(path,std::filesystem::file_time_type::clock::now(),ec);
+        }
+    }
+
+    std::string    MatrixCache::directory = default_directory();
+    std::uintmax_t MatrixCache::max_size  = default_max_size();
+
+    MatrixCache::MatrixCache(const std::string& k): kind(k) {
+        key.add(std::string(version));
+        key.add(CacheVersion);
+        key.add(kind);
+    }
+
+    //  The geometry is identified by what the assembly actually uses: vertices with their unknown indices
+    //  (which also captures the ordering), triangles, the mesh/domain structure (with the composition and
+    //  orientations of the interfaces) and the conductivities (or only which ones are zero).
+
+    MatrixCache& MatrixCache::add(const Geometry& geo,const bool conductivities) {
+        const Vertex* vertex0 = geo.vertices().data();
+        const Mesh*   mesh0   = geo.meshes().data();
+
+        key.add(geo.vertices().size());
+        for (const auto& vertex : geo.vertices()) {
+            key.add(&static_cast<const Vect3&>(vertex),sizeof(Vect3));
+            key.add(vertex.index());
+        }
+
+        key.add(geo.meshes().size());
+        for (const auto& mesh : geo.meshes()) {
+            key.add(mesh.name());
+            key.add(mesh.current_barrier());
+            key.add(mesh.triangles().size());
+            for (const auto& triangle : mesh.triangles()) {
+                for (unsigned i=0;i<3;++i)
+                    key.add(static_cast<uint64_t>(&triangle.vertex(i)-vertex0));
+                key.add(triangle.index());
+            }
+        }
+
+        key.add(geo.domains().size());
+        for (const auto& domain : geo.domains()) {
+            key.add(domain.name());
+            if (conductivities)
+                key.add(domain.conductivity());
+            else
+                key.add(domain.conductivity()==0.0);
+            key.add(domain.boundaries().size());
+            for (const auto& boundary : domain.boundaries()) {
+                const Interface& interface = boundary.interface();
+                key.add(boundary.inside());
+                key.add(interface.name());
+                key.add(interface.oriented_meshes().size());
+                for (const auto& omesh : interface.oriented_meshes()) {
+                    key.add(static_cast<uint64_t>(&omesh.mesh()-mesh0));
+                    key.add(omesh.orientation());
+                }
+            }
+        }
+        return *this;
+    }
+
+    MatrixCache& MatrixCache::operator<<(const Sensors& sensors) {
+        for (const auto& name : sensors.getNames())
+            key.add(name);
+        return *this << sensors.getPositions() << sensors.getOrientations() << sensors.getWeights() << sensors.getRadii();
+    }
+
+    MatrixCache& MatrixCache::operator<<(const Vector& V) {
+        key.add(V.size());
+        key.add(V.data(),V.size()*sizeof(double));
+        return *this;
+    }
+
+    MatrixCache& MatrixCache::operator<<(const Matrix& M) {
+        key.add(M.nlin());
+        key.add(M.ncol());
+        key.add(M.data(),M.size()*sizeof(double));
+        return *this;
+    }
+
+    MatrixCache& MatrixCache::operator<<(const SymMatrix& M) {
+        key.add(M.nlin());
+        key.add(M.data(),M.size()*sizeof(double));
+        return *this;
+    }
+
+    MatrixCache& MatrixCache::operator<<(const SparseMatrix& M) {
+        key.add(M.nlin());
+        key.add(M.ncol());
+        for (const auto& entry : M) {
+            key.add(entry.first.first);
+            key.add(entry.first.second);
+            key.add(entry.second);
+        }
+        return *this;
+    }
+
+    std::string MatrixCache::filename() const {
+        return (std::filesystem::path(directory)/(kind+"-"+key.hex()+Extension)).string();
+    }
+
+    //  The extension is kept last as it selects the file format.
+
+    std::string MatrixCache::temporary() const {
+        std::error_code ec;
+        std::filesystem::create_directories(directory,ec);
+        return (std::filesystem::path(directory)/(kind+"-"+key.hex()+"-"+std::to_string(std::random_device()())+".tmp"+Extension)).string();
+    }
+
+    bool MatrixCache::lookup() const {
+        if (!enabled())
+            return false;
+        const std::filesystem::path path(filename());
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path,ec))
+            return false;
+        touch(path); // Entries are evicted in least recently used order.
+        return true;
+    }
+
+    //  Rename the complete file, so that concurrent commands never see a partial entry.
+
+    void MatrixCache::commit(const std::string& tmpname) const {
+        const std::string& name = filename();
+        std::error_code ec;
+        std::filesystem::rename(tmpname,name,ec);
+        if (ec) {
+            discard(tmpname);
+            return;
+        }
+        evict(name);
+    }
+
+    void MatrixCache::discard(const std::string& name) {
+        std::error_code ec;
+        std::filesystem::remove(name,ec);
+    }
+
+    void MatrixCache::evict(const std::string& keep) {
+        if (max_size==0)
+            return;
+
+        struct Entry {
+            std::filesystem::path           path;
+            std::filesystem::file_time_type time;
+            std::uintmax_t                  size;
+        };
+
+        std::vector<Entry> entries;
+        std::uintmax_t total = 0;
+        std::error_code ec;
+        for (const auto& file : std::filesystem::directory_iterator(directory,ec)) {
+            const std::string& name = file.path().filename().string();
+            if (!file.is_regular_file(ec) || file.path().extension()!=Extension || name.find(".tmp")!=std::string::npos)
+                continue;
+            const Entry entry = { file.path(),file.last_write_time(ec),file.file_size(ec) };
+            if (ec)
+                continue;
+            total += entry.size;
+            entries.push_back(entry);
+        }
+
+        std::sort(entries.begin(),entries.end(),[](const Entry& e1,const Entry& e2) { return e1.time<e2.time; });
+        for (const auto& entry : entries) {
+            if (total<=max_size)
+                break;
+            if (entry.path==keep)
+                continue;
+            if (std::filesystem::remove(entry.path,ec))
+                total -= entry.size;
+        }
+    }
+}
@@ -37,87 +37,201 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <algorithm>
+#include <cstdint>
+
+#ifdef USE_OMP
+#include <omp.h>
+#endif
+
 #include <operators.h>
 
 namespace OpenMEEG {
 
-    // TODO: Use overloading and remove the internal suffix.
+    namespace {
 
-    void operatorDinternal(const Mesh& m,Matrix& mat,const Vertices& points,const double& coeff) {
-        std::cout << "INTERNAL OPERATOR D..." << std::endl;
-        for (const auto& vertex : points)
-            for (const auto& triangle : m.triangles()) {
-                analyticD3 analyD(triangle);
-                const Vect3 total = analyD.f(vertex);
-                for (unsigned i=0;i<3;++i)
-                    mat(vertex.index(),triangle.vertex(i).index()) += total(i)*coeff;
+        //  Per triangle data of the internal operators: the analytic kernels for the points close to the triangle
+        //  and the 6 points Gauss rule (order 1 of the Integrator) for the distant ones. With n the normal oriented
+        //  by the vertex order (as in analyticD3), the quadrature of D for the P1 function of vertex i is
+        //  sum_q w_q phi_i(y_q) <n,y_q-x>/|y_q-x|^3 and the one of S is <T.normal(),n> sum_q w_q/|y_q-x|
+        //  (analyticS(T) changes sign when the triangle normal is opposite to n).
+
+        struct InternalTriangle {
+
+            InternalTriangle(const Triangle& T): triangle(T), analyS(T), analyD(T) {
+                const Vect3* v[3] = { &T.vertex(0), &T.vertex(1), &T.vertex(2) };
+                center = (*v[0]+*v[1]+*v[2])/3.0;
+                radius2 = 0.0;
+                for (unsigned k=0; k<3; ++k)
+                    radius2 = std::max(radius2,(*v[k]-center).norm2());
+                const Vect3& N = (*v[1]-*v[0])^(*v[2]-*v[0]);
+                const double twice_area = N.norm();
+                normal = N/twice_area;
+                orientation = dotprod(T.normal(),normal);
+                for (unsigned q=0; q<6; ++q) {
+                    points[q] = Vect3(0.0,0.0,0.0);
+                    for (unsigned k=0; k<3; ++k) {
+                        points[q].multadd(cordBars[1][q][k],*v[k]);
+                        phi[q][k] = cordBars[1][q][k];
+                    }
+                    weights[q] = cordBars[1][q][3]*twice_area;
+                }
             }
+
+            bool far(const Vect3& x,const double theta2) const { return radius2<theta2*(x-center).norm2(); }
+
+            double S(const Vect3& x) const {
+                double result = 0.0;
+                for (unsigned q=0; q<6; ++q)
+                    result += weights[q]/(points[q]-x).norm();
+                return orientation*result;
+            }
+
+            Vect3 D(const Vect3& x) const {
+                Vect3 result(0.0,0.0,0.0);
+                for (unsigned q=0; q<6; ++q) {
+                    const Vect3& r  = points[q]-x;
+                    const double r2 = r.norm2();
+                    const double g  = weights[q]*dotprod(normal,r)/(r2*std::sqrt(r2));
+                    for (unsigned k=0; k<3; ++k)
+                        result(k) += g*phi[q][k];
+                }
+                return result;
+            }
+
+            const Triangle&  triangle;
+            const analyticS  analyS;
+            const analyticD3 analyD;
+            Vect3            center;
+            double           radius2;
+            Vect3            normal;
+            double           orientation;
+            Vect3            points[6];
+            double           weights[6];
+            double           phi[6][3];
+        };
     }
 
-    void operatorSinternal(const Mesh& m,Matrix& mat,const Vertices& points,const double& coeff) {
-        std::cout << "INTERNAL OPERATOR S..." << std::endl;
-        for (const auto& vertex : points) {
-            const unsigned vindex = vertex.index();
-            for (const auto& triangle : m.triangles()) {
-                const unsigned tindex = triangle.index();
-                const analyticS analyS(triangle);
-                mat(vindex,tindex) = coeff*analyS.f(vertex);
+    //  Points are processed in parallel by blocks (each thread writes its own lines of mat) and the triangle data
+    //  is computed once for all the points. When theta is positive, a triangle seen from a point with an angle
+    //  (radius/distance) smaller than theta is integrated with the Gauss rule instead of the analytic formulas.
+
+    void operatorInternal(const Mesh& m,Matrix& mat,const Vertices& points,const double coeffD,const double coeffS,const double theta) {
+        const ScopedTimer timer("operator internal");
+
+        std::vector<InternalTriangle> triangles;
+        triangles.reserve(m.triangles().size());
+        for (const auto& triangle : m.triangles())
+            triangles.push_back(InternalTriangle(triangle));
+
+        const unsigned BlockSize = 64;
+        const int      nblocks   = (points.size()+BlockSize-1)/BlockSize;
+        const double   theta2    = theta*theta;
+
+        uint64_t exact = 0;
+        #pragma omp parallel for schedule(dynamic) reduction(+:exact)
+        for (int b=0; b<nblocks; ++b) {
+            const ThreadTimer busy;
+            const size_t first = b*BlockSize;
+            const size_t last  = std::min<size_t>(first+BlockSize,points.size());
+            for (const auto& T : triangles) {
+                const unsigned tindex = T.triangle.index();
+                for (size_t i=first; i<last; ++i) {
+                    const Vertex&  vertex = points[i];
+                    const unsigned vindex = vertex.index();
+                    const bool     far    = T.far(vertex,theta2);
+                    exact += !far;
+                    if (coeffD!=0.0) {
+                        const Vect3& total = (far) ? T.D(vertex) : T.analyD.f(vertex);
+                        for (unsigned k=0; k<3; ++k)
+                            mat(vindex,T.triangle.vertex(k).index()) += total(k)*coeffD;
+                    }
+                    if (coeffS!=0.0)
+                        mat(vindex,tindex) = coeffS*((far) ? T.S(vertex) : T.analyS.f(vertex));
+                }
             }
         }
+        Profiler::count(Profiler::KernelEvaluations,exact);
     }
 
-    // General routine for applying Details::operatorFerguson (see this function for further comments)
-    // to an entire mesh, and storing coordinates of the output in a Matrix.
+    void operatorDinternal(const Mesh& m,Matrix& mat,const Vertices& points,const double& coeff,const double theta) {
+        std::cout << "INTERNAL OPERATOR D..." << std::endl;
+        operatorInternal(m,mat,points,coeff,0.0,theta);
+    }
 
-    void operatorFerguson(const Vect3& x,const Mesh& m,Matrix& mat,const unsigned& offsetI,const double& coeff) {
-        #pragma omp parallel for
-        #if defined NO_OPENMP || defined OPENMP_RANGEFOR
-        for (const auto& vertexp : m.vertices()) {
-        #elif defined OPENMP_ITERATOR
-        for (auto vit=m.vertices().begin();vit<m.vertices().end();++vit) {
-            const Vertex* vertexp = *vit;
-        #else
-        for (int i=0;i<m.vertices().size();++i) {
-            const Vertex* vertexp = *(m.vertices().begin()+i);
-        #endif
-            const unsigned vindex = vertexp->index();
-            Vect3 v = Details::operatorFerguson(x,*vertexp,m);
-            mat(offsetI+0,vindex) += v.x()*coeff;
-            mat(offsetI+1,vindex) += v.y()*coeff;
-            mat(offsetI+2,vindex) += v.z()*coeff;
-        }
+    void operatorSinternal(const Mesh& m,Matrix& mat,const Vertices& points,const double& coeff,const double theta) {
+        std::cout << "INTERNAL OPERATOR S..." << std::endl;
+        operatorInternal(m,mat,points,0.0,coeff,theta);
     }
 
     void operatorDipolePotDer(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
-        static analyticDipPotDer anaDPD;
-
         Integrator<Vect3,analyticDipPotDer>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<Vect3,analyticDipPotDer>(0.001) :
                                                                    new Integrator<Vect3,analyticDipPotDer>;
 
         gauss->setOrder(gauss_order);
-        #pragma omp parallel for private(anaDPD)
-        #if defined NO_OPENMP || defined OPENMP_RANGEFOR
-        for (const auto& triangle : m.triangles()) {
-        #elif defined OPENMP_ITERATOR
-        for (Triangles::const_iterator tit=m.triangles().begin();tit<m.triangles().end();++tit) {
-            const Triangle& triangle = *tit;
+
+        const auto integrate = [&](const Triangle& triangle) {
+            const ThreadTimer busy;
+            analyticDipPotDer anaDPD;
+            anaDPD.init(triangle,q,r0);
+            return gauss->integrate(anaDPD,triangle);
+        };
+
+        //  Vertices are shared by neighbouring triangles. When called from a parallel region (e.g. by DipSourceMat,
+        //  which computes the dipoles in parallel), the loop runs sequentially and rhs is updated directly.
+        //  Otherwise, each thread accumulates its contributions over the range of the mesh vertex indices and adds
+        //  them to rhs once at the end of the loop.
+
+        #ifdef USE_OMP
+        const bool sequential = omp_in_parallel() || omp_get_max_threads()==1 || m.vertices().empty();
         #else
-        for (int i=0;i<m.triangles().size();++i) {
-            const Triangle& triangle = *(m.triangles().begin()+i);
+        const bool sequential = true;
         #endif
-            anaDPD.init(triangle,q,r0);
-            Vect3 v = gauss->integrate(anaDPD,triangle);
-            #pragma omp critical
-            {
+
+        if (sequential) {
+            for (const auto& triangle : m.triangles()) {
+                const Vect3& v = integrate(triangle);
                 for (unsigned i=0;i<3;++i)
                     rhs(triangle.vertex(i).index()) += v(i)*coeff;
             }
+            delete gauss;
+            return;
+        }
+
+        const auto& range = std::minmax_element(m.vertices().begin(),m.vertices().end(),
+                                                [](const Vertex* v1,const Vertex* v2) { return v1->index()<v2->index(); });
+        const unsigned first = (*range.first)->index();
+        const unsigned nvertices = (*range.second)->index()-first+1;
+
+        #pragma omp parallel
+        {
+            Vector local(nvertices);
+            local.set(0.0);
+
+            #pragma omp for
+            #if defined NO_OPENMP || defined OPENMP_RANGEFOR
+            for (const auto& triangle : m.triangles()) {
+            #elif defined OPENMP_ITERATOR
+            for (Triangles::const_iterator tit=m.triangles().begin();tit<m.triangles().end();++tit) {
+                const Triangle& triangle = *tit;
+            #else
+            for (int i=0;i<m.triangles().size();++i) {
+                const Triangle& triangle = *(m.triangles().begin()+i);
+            #endif
+                const Vect3& v = integrate(triangle);
+                for (unsigned i=0;i<3;++i)
+                    local(triangle.vertex(i).index()-first) += v(i)*coeff;
+            }
+
+            #pragma omp critical(operatorDipolePotDer)
+            for (unsigned i=0;i<nvertices;++i)
+                rhs(first+i) += local(i);
         }
         delete gauss;
     }
 
     void operatorDipolePot(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
-        static analyticDipPot anaDP;
+        analyticDipPot anaDP;
 
         anaDP.init(q,r0);
         Integrator<double,analyticDipPot>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<double,analyticDipPot>(0.001) :
@@ -134,9 +248,9 @@ namespace OpenMEEG {
         for (int i=0;i<m.triangles().size();++i) {
             const Triangle& triangle = *(m.triangles().begin()+i);
         #endif
+            const ThreadTimer busy;
             const double d = gauss->integrate(anaDP,triangle);
-            #pragma omp critical
-            rhs(triangle.index()) += d*coeff;
+            rhs(triangle.index()) += d*coeff; // Each triangle has its own entry: no synchronization is needed.
         }
         delete gauss;
     }
@@ -0,0 +1,239 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+#include <GeometryExceptions.H>
+#include <rectilinear_grid.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Position of a point p of the (y,z) plane with respect to the edge (a,b) of a counterclockwise triangle.
+        //  Points on the edge are attributed to only one of the two triangles sharing it, so that a line going
+        //  through an edge or a vertex crosses the surface only once.
+
+        bool inside_edge(const double ay,const double az,const double by,const double bz,const double py,const double pz) {
+            const double dy = by-ay;
+            const double dz = bz-az;
+            const double e  = dy*(pz-az)-dz*(py-ay);
+            return (e>0.0) || (e==0.0 && (dy>0.0 || (dy==0.0 && dz>0.0)));
+        }
+    }
+
+    void RectilinearGrid::check() const {
+        for (unsigned c=0; c<3; ++c) {
+            if (coords[c].empty())
+                throw BadData("rectilinear grid (empty coordinates)");
+            for (size_t i=1; i<coords[c].size(); ++i)
+                if (coords[c][i]<=coords[c][i-1])
+                    throw BadData("rectilinear grid (coordinates must be increasing)");
+        }
+    }
+
+    void RectilinearGrid::load(const std::string& filename) {
+        std::ifstream ifs(filename.c_str());
+        if (!ifs.is_open())
+            throw OpenError(filename);
+
+        std::string line;
+        std::getline(ifs,line); // # vtk DataFile Version x.x
+        std::getline(ifs,line); // Title
+
+        std::string format,dataset,type;
+        ifs >> format >> dataset >> type;
+        if (format!="ASCII" || dataset!="DATASET" || type!="RECTILINEAR_GRID")
+            throw BadHeader(ifs,"VTK rectilinear grid");
+
+        std::string keyword;
+        size_t dims[3];
+        ifs >> keyword >> dims[0] >> dims[1] >> dims[2];
+        if (keyword!="DIMENSIONS")
+            throw BadHeader(ifs,"VTK rectilinear grid");
+
+        const char* names[3] = { "X_COORDINATES", "Y_COORDINATES", "Z_COORDINATES" };
+        for (unsigned c=0; c<3; ++c) {
+            size_t n;
+            ifs >> keyword >> n >> type;
+            if (keyword!=names[c] || n!=dims[c])
+                throw BadHeader(ifs,"VTK rectilinear grid");
+            coords[c].resize(n);
+            for (auto& x : coords[c])
+                ifs >> x;
+        }
+        if (ifs.fail())
+            throw BadData("VTK rectilinear grid");
+
+        check();
+    }
+
+    void RectilinearGrid::save(const std::string& filename) const {
+        std::ofstream ofs(filename.c_str());
+        if (!ofs.is_open())
+            throw OpenError(filename);
+
+        ofs << "# vtk DataFile Version 2.0" << std::endl
+            << "File " << filename << std::endl
+            << "ASCII" << std::endl
+            << "DATASET RECTILINEAR_GRID" << std::endl
+            << "DIMENSIONS " << coords[0].size() << ' ' << coords[1].size() << ' ' << coords[2].size() << std::endl;
+
+        const char* names[3] = { "X_COORDINATES", "Y_COORDINATES", "Z_COORDINATES" };
+        ofs << std::setprecision(15);
+        for (unsigned c=0; c<3; ++c) {
+            ofs << names[c] << ' ' << coords[c].size() << " double" << std::endl;
+            for (const auto& x : coords[c])
+                ofs << x << std::endl;
+        }
+    }
+
+    Matrix RectilinearGrid::points() const {
+        Matrix mat(nb_points(),3);
+        for (size_t i=0; i<nb_points(); ++i) {
+            const Vect3& p = point(i);
+            for (unsigned c=0; c<3; ++c)
+                mat(i,c) = p(c);
+        }
+        return mat;
+    }
+
+    std::vector<const Domain*> RectilinearGrid::domains(const Geometry& geo) const {
+
+        const Coordinates& x = coords[0];
+        const Coordinates& y = coords[1];
+        const Coordinates& z = coords[2];
+        const size_t nx = x.size();
+        const size_t ny = y.size();
+        const size_t nz = z.size();
+
+        //  Crossings of the x lines (indexed by j+ny*k) with each interface.
+
+        std::map<const Interface*,unsigned> interfaces;
+        for (const auto& domain : geo.domains())
+            for (const auto& boundary : domain.boundaries())
+                interfaces.insert({ &boundary.interface(), interfaces.size() });
+
+        typedef std::vector<std::vector<double>> Crossings;
+        std::vector<Crossings> crossings(interfaces.size(),Crossings(ny*nz));
+
+        for (const auto& interface : interfaces) {
+            Crossings& lines = crossings[interface.second];
+            for (const auto& omesh : interface.first->oriented_meshes())
+                for (const auto& triangle : omesh.mesh().triangles()) {
+                    const Vect3* v[3] = { &triangle.vertex(0), &triangle.vertex(1), &triangle.vertex(2) };
+
+                    //  Orient the projection of the triangle on the (y,z) plane counterclockwise.
+
+                    const double area = (v[1]->y()-v[0]->y())*(v[2]->z()-v[0]->z())-(v[1]->z()-v[0]->z())*(v[2]->y()-v[0]->y());
+                    if (area==0.0)
+                        continue;
+                    if (area<0.0)
+                        std::swap(v[1],v[2]);
+
+                    const double ymin = std::min({ v[0]->y(), v[1]->y(), v[2]->y() });
+                    const double ymax = std::max({ v[0]->y(), v[1]->y(), v[2]->y() });
+                    const double zmin = std::min({ v[0]->z(), v[1]->z(), v[2]->z() });
+                    const double zmax = std::max({ v[0]->z(), v[1]->z(), v[2]->z() });
+                    const size_t j0 = std::lower_bound(y.begin(),y.end(),ymin)-y.begin();
+                    const size_t j1 = std::upper_bound(y.begin(),y.end(),ymax)-y.begin();
+                    const size_t k0 = std::lower_bound(z.begin(),z.end(),zmin)-z.begin();
+                    const size_t k1 = std::upper_bound(z.begin(),z.end(),zmax)-z.begin();
+
+                    for (size_t k=k0; k<k1; ++k)
+                        for (size_t j=j0; j<j1; ++j) {
+                            bool inside = true;
+                            for (unsigned e=0; e<3 && inside; ++e) {
+                                const Vect3& a = *v[e];
+                                const Vect3& b = *v[(e+1)%3];
+                                inside = inside_edge(a.y(),a.z(),b.y(),b.z(),y[j],z[k]);
+                            }
+                            if (!inside)
+                                continue;
+
+                            //  Barycentric interpolation of the x coordinate of the crossing.
+
+                            const double py = y[j]-v[0]->y();
+                            const double pz = z[k]-v[0]->z();
+                            const Vect3& e1 = *v[1]-*v[0];
+                            const Vect3& e2 = *v[2]-*v[0];
+                            const double w1 = (py*e2.z()-pz*e2.y())/std::abs(area);
+                            const double w2 = (e1.y()*pz-e1.z()*py)/std::abs(area);
+                            lines[j+ny*k].push_back(v[0]->x()+w1*e1.x()+w2*e2.x());
+                        }
+                }
+            for (auto& line : lines)
+                std::sort(line.begin(),line.end());
+        }
+
+        //  A point is inside an interface if it is followed by an odd number of crossings of its x line.
+
+        std::vector<std::vector<std::pair<unsigned,bool>>> boundaries;
+        for (const auto& domain : geo.domains()) {
+            boundaries.push_back({});
+            for (const auto& boundary : domain.boundaries())
+                boundaries.back().push_back({ interfaces[&boundary.interface()], boundary.inside() });
+        }
+
+        std::vector<const Domain*> result(nb_points(),nullptr);
+        std::vector<bool> inside(interfaces.size());
+        for (size_t l=0; l<ny*nz; ++l)
+            for (size_t i=0; i<nx; ++i) {
+                for (const auto& interface : interfaces) {
+                    const std::vector<double>& line = crossings[interface.second][l];
+                    const size_t after = line.end()-std::upper_bound(line.begin(),line.end(),x[i]);
+                    inside[interface.second] = (after%2==1);
+                }
+                for (unsigned d=0; d<boundaries.size() && result[i+nx*l]==nullptr; ++d) {
+                    bool in = true;
+                    for (const auto& boundary : boundaries[d])
+                        in = in && (inside[boundary.first]==boundary.second);
+                    if (in)
+                        result[i+nx*l] = &geo.domains()[d];
+                }
+                if (result[i+nx*l]==nullptr)
+                    throw BadDomain("Impossible");
+            }
+
+        return result;
+    }
+}
@@ -42,6 +42,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <algorithm>
 #include <ciso646>
 #include <iterator>     // std::distance
+#include <numeric>
 #include <vector>
 #include <stack>
 
@@ -219,10 +220,64 @@ namespace OpenMEEG {
     }
 
     SparseMatrix Sensors::getWeightsMatrix() const {
-        SparseMatrix weight_matrix(getNumberOfSensors(),getNumberOfPositions());
+        SparseMatrix::Builder weight_matrix(getNumberOfSensors(),getNumberOfPositions());
+        weight_matrix.reserve(getNumberOfPositions());
         for(size_t i=0; i<getNumberOfPositions(); ++i)
-            weight_matrix(m_pointSensorIdx[i],i) = m_weights(i);
-        return weight_matrix;
+            weight_matrix.insert(m_pointSensorIdx[i],i,m_weights(i));
+        return SparseMatrix(weight_matrix);
+    }
+
+    namespace {
+        std::vector<size_t> all_sensors(const Sensors& sensors) {
+            std::vector<size_t> selection(sensors.getNumberOfSensors());
+            std::iota(selection.begin(),selection.end(),0);
+            return selection;
+        }
+    }
+
+    SensorCoils::SensorCoils(const Sensors& sensors): SensorCoils(sensors,all_sensors(sensors)) { }
+
+    SensorCoils::SensorCoils(const Sensors& sensors,const std::vector<size_t>& selection): offsets(selection.size()+1,0) {
+
+        const size_t n = sensors.getNumberOfPositions();
+        const std::vector<size_t>& sensor_index = sensors.m_pointSensorIdx;
+
+        // Coil of each sensor (selection.size() for the sensors which are not selected).
+
+        const size_t none = selection.size();
+        std::vector<size_t> coil_of(sensors.getNumberOfSensors(),none);
+        for (size_t k=0; k<selection.size(); ++k)
+            coil_of[selection[k]] = k;
+
+        // Counting sort of the integration points by coil (the order of the points of a sensor is kept).
+
+        for (size_t i=0; i<n; ++i)
+            if (coil_of[sensor_index[i]]!=none)
+                ++offsets[coil_of[sensor_index[i]]+1];
+        for (size_t s=0; s<nb_sensors(); ++s)
+            offsets[s+1] += offsets[s];
+
+        const size_t m = offsets.back();
+        coil.resize(m);
+        points.resize(m);
+        positions.resize(m);
+        directions.resize(m,Vect3(0.0,0.0,0.0));
+
+        std::vector<size_t> next(offsets.begin(),offsets.end()-1);
+        for (size_t i=0; i<n; ++i) {
+            const size_t s = coil_of[sensor_index[i]];
+            if (s==none)
+                continue;
+            const size_t j = next[s]++;
+            coil[j]      = s;
+            points[j]    = i;
+            positions[j] = Vect3(sensors.m_positions(i,0),sensors.m_positions(i,1),sensors.m_positions(i,2));
+            if (sensors.hasOrientations()) {
+                Vect3 direction(sensors.m_orientations(i,0),sensors.m_orientations(i,1),sensors.m_orientations(i,2));
+                direction.normalize();
+                directions[j] = sensors.m_weights(i)*direction;
+            }
+        }
     }
 
     void Sensors::findInjectionTriangles() {
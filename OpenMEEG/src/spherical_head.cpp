@@ -0,0 +1,258 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <constants.h>
+#include <geometry.h>
+#include <GeometryExceptions.H>
+#include <spherical_head.h>
+
+namespace OpenMEEG {
+
+    void icosphere(const unsigned subdivisions,Vertices& vertices,std::vector<TriangleIndices>& triangles) {
+
+        const double t = (1.0+std::sqrt(5.0))/2.0;
+
+        vertices = {
+            Vertex(-1,t,0), Vertex(1,t,0), Vertex(-1,-t,0), Vertex(1,-t,0),
+            Vertex(0,-1,t), Vertex(0,1,t), Vertex(0,-1,-t), Vertex(0,1,-t),
+            Vertex(t,0,-1), Vertex(t,0,1), Vertex(-t,0,-1), Vertex(-t,0,1)
+        };
+
+        triangles = {
+            {0,11,5}, {0,5,1}, {0,1,7}, {0,7,10}, {0,10,11}, {1,5,9}, {5,11,4}, {11,10,2}, {10,7,6}, {7,1,8},
+            {3,9,4}, {3,4,2}, {3,2,6}, {3,6,8}, {3,8,9}, {4,9,5}, {2,4,11}, {6,2,10}, {8,6,7}, {9,8,1}
+        };
+
+        for (auto& vertex : vertices)
+            vertex.normalize();
+
+        for (unsigned l=0; l<subdivisions; ++l) {
+
+            //  Edge middles are shared by the two adjacent triangles.
+
+            std::map<std::pair<unsigned,unsigned>,unsigned> middles;
+            auto middle = [&](const unsigned i,const unsigned j) {
+                const std::pair<unsigned,unsigned> edge(std::min(i,j),std::max(i,j));
+                const auto it = middles.find(edge);
+                if (it!=middles.end())
+                    return it->second;
+                Vertex m(0.5*(vertices[i]+vertices[j]));
+                m.normalize();
+                vertices.push_back(m);
+                return middles[edge] = vertices.size()-1;
+            };
+
+            std::vector<TriangleIndices> refined;
+            refined.reserve(4*triangles.size());
+            for (const auto& triangle : triangles) {
+                const unsigned a = middle(triangle[0],triangle[1]);
+                const unsigned b = middle(triangle[1],triangle[2]);
+                const unsigned c = middle(triangle[2],triangle[0]);
+                refined.push_back({ triangle[0], a, c });
+                refined.push_back({ triangle[1], b, a });
+                refined.push_back({ triangle[2], c, b });
+                refined.push_back({ a, b, c });
+            }
+            triangles.swap(refined);
+        }
+    }
+
+    SphericalHead::SphericalHead(const unsigned subdivisions,const Layers& layers): head_layers(layers) {
+        if (layers.empty())
+            throw std::invalid_argument("A spherical head needs at least one layer.");
+        for (unsigned i=0; i<layers.size(); ++i)
+            if (layers[i].radius<=((i==0) ? 0.0 : layers[i-1].radius))
+                throw std::invalid_argument("Spherical head radii must be positive and increasing.");
+        icosphere(subdivisions,vertices,triangles);
+    }
+
+    SphericalHead::Layers SphericalHead::default_layers(const unsigned n) {
+        switch (n) {
+            case 1:
+                return { { "Brain", 1.0, 1.0 } };
+            case 2:
+                return { { "Brain", 0.92, 1.0 }, { "Scalp", 1.0, 1.0 } };
+            case 3:
+                return { { "Brain", 0.87, 1.0 }, { "Skull", 0.92, 0.0125 }, { "Scalp", 1.0, 1.0 } };
+            case 4:
+                return { { "Brain", 0.85, 1.0 }, { "CSF", 0.87, 4.0 }, { "Skull", 0.92, 0.0125 }, { "Scalp", 1.0, 1.0 } };
+            default: {
+                Layers layers;
+                for (unsigned i=1; i<=n; ++i)
+                    layers.push_back({ "Layer"+std::to_string(i), 0.5+0.5*i/n, 1.0 });
+                return layers;
+            }
+        }
+    }
+
+    void SphericalHead::save(const std::string& basename,const unsigned nb_dipoles,const unsigned nb_electrodes,const unsigned nb_squids) const {
+        save_meshes(basename);
+        save_geometry(basename);
+        save_conductivities(basename);
+        save_dipoles(basename+".dip",nb_dipoles);
+        save_electrodes(basename+".patches",nb_electrodes);
+        save_squids(basename+".squids",nb_squids);
+    }
+
+    namespace {
+
+        std::ofstream output_file(const std::string& filename) {
+            std::ofstream ofs(filename);
+            if (!ofs)
+                throw OpenError(filename);
+            ofs << std::setprecision(15);
+            return ofs;
+        }
+
+        std::string mesh_filename(const std::string& basename,const SphericalHead::Layer& layer) {
+            return basename+"-"+layer.name+".tri";
+        }
+
+        //  Geometry files reference meshes relatively to their own directory.
+
+        std::string file_part(const std::string& filename) {
+            const std::string::size_type pos = filename.find_last_of("/\\");
+            return (pos==std::string::npos) ? filename : filename.substr(pos+1);
+        }
+
+        //  Evenly distributed directions (Fibonacci spiral) with z in [zmin,1].
+
+        Vect3 spiral(const unsigned i,const unsigned n,const double zmin) {
+            const double golden = Pi*(3.0-std::sqrt(5.0));
+            const double z      = 1.0-(1.0-zmin)*(i+0.5)/n;
+            const double r      = std::sqrt(1.0-z*z);
+            return Vect3(r*std::cos(golden*i),r*std::sin(golden*i),z);
+        }
+    }
+
+    void SphericalHead::save_meshes(const std::string& basename) const {
+        for (const auto& layer : head_layers) {
+            Mesh mesh(vertices.size(),triangles.size());
+            Vertices& points = mesh.geometry().vertices();
+            for (const auto& vertex : vertices) {
+                points.push_back(layer.radius*vertex);
+                mesh.vertices().push_back(&points.back());
+            }
+            for (const auto& triangle : triangles)
+                mesh.add_triangle(triangle);
+            mesh.update(true);
+            mesh.save(mesh_filename(basename,layer));
+        }
+    }
+
+    void SphericalHead::save_geometry(const std::string& basename) const {
+        std::ofstream ofs = output_file(basename+".geom");
+
+        ofs << "# Domain Description 1.1" << std::endl << std::endl
+            << "Meshes " << head_layers.size() << std::endl;
+        for (const auto& layer : head_layers)
+            ofs << "Mesh " << layer.name << ": \"" << file_part(mesh_filename(basename,layer)) << '"' << std::endl;
+
+        ofs << std::endl << "Interfaces " << head_layers.size() << std::endl;
+        for (const auto& layer : head_layers)
+            ofs << "Interface " << layer.name << ": " << layer.name << std::endl;
+
+        ofs << std::endl << "Domains " << head_layers.size()+1 << std::endl;
+        for (unsigned i=0; i<head_layers.size(); ++i) {
+            ofs << "Domain " << head_layers[i].name << ": -" << head_layers[i].name;
+            if (i!=0)
+                ofs << " +" << head_layers[i-1].name;
+            ofs << std::endl;
+        }
+        ofs << "Domain Air: +" << head_layers.back().name << std::endl;
+    }
+
+    void SphericalHead::save_conductivities(const std::string& basename) const {
+        std::ofstream ofs = output_file(basename+".cond");
+        ofs << "# Properties Description 1.0 (Conductivities)" << std::endl << std::endl
+            << "Air 0.0" << std::endl;
+        for (const auto& layer : head_layers)
+            ofs << layer.name << ' ' << layer.conductivity << std::endl;
+    }
+
+    void SphericalHead::save_dipoles(const std::string& filename,const unsigned n) const {
+
+        //  Dipoles are at depths between 10% and 90% of the innermost radius, alternately radial and tangential.
+
+        std::ofstream ofs = output_file(filename);
+        const double golden = (std::sqrt(5.0)-1.0)/2.0;
+        for (unsigned i=0; i<n; ++i) {
+            const Vect3& direction = spiral(i,n,-1.0);
+            const double depth = 0.1+0.8*std::fmod(golden*i,1.0);
+            const Vect3& position = (1.0-depth)*head_layers.front().radius*direction;
+            Vect3 moment = direction;
+            if (i%2==1) {
+                const Vect3 axis = (std::abs(direction.z())<0.9) ? Vect3(0,0,1) : Vect3(1,0,0);
+                moment = crossprod(direction,axis);
+                moment.normalize();
+            }
+            ofs << position.x() << ' ' << position.y() << ' ' << position.z() << ' '
+                << moment.x() << ' ' << moment.y() << ' ' << moment.z() << std::endl;
+        }
+    }
+
+    void SphericalHead::save_electrodes(const std::string& filename,const unsigned n) const {
+        std::ofstream ofs = output_file(filename);
+        const double R = head_layers.back().radius;
+        for (unsigned i=0; i<n; ++i) {
+            const Vect3& position = R*spiral(i,n,0.0);
+            ofs << "EEG" << std::setw(3) << std::setfill('0') << i+1 << std::setfill(' ') << ' '
+                << position.x() << ' ' << position.y() << ' ' << position.z() << std::endl;
+        }
+    }
+
+    void SphericalHead::save_squids(const std::string& filename,const unsigned n) const {
+        std::ofstream ofs = output_file(filename);
+        const double R = 1.15*head_layers.back().radius;
+        for (unsigned i=0; i<n; ++i) {
+            const Vect3& direction = spiral(i,n,0.0);
+            const Vect3& position  = R*direction;
+            ofs << "MEG" << std::setw(3) << std::setfill('0') << i+1 << std::setfill(' ') << ' '
+                << position.x() << ' ' << position.y() << ' ' << position.z() << ' '
+                << direction.x() << ' ' << direction.y() << ' ' << direction.z() << " 1" << std::endl;
+        }
+    }
+}
@@ -12,6 +12,10 @@
         void LAPACK(dpptri,DPPTRI)(const char&,const int&,double*,int&);
         void LAPACK(dspevd,DSPEVD)(const char&,const char&,const int&,double*,double*,double*,const int&,double*,const int&,int*,const int&,int&);
         void LAPACK(dsptrs,DSPTRS)(const char&,const int&,const int&,double*,int*,double*,const int&,int&);
+        void LAPACK(ssptrf,SSPTRF)(const char&,const int&,float*,int*,int&);
+        void LAPACK(ssptrs,SSPTRS)(const char&,const int&,const int&,float*,int*,float*,const int&,int&);
+        void LAPACK(dgehrd,DGEHRD)(const int&,const int&,const int&,double*,const int&,double*,double*,const int&,int&);
+        void LAPACK(dorghr,DORGHR)(const int&,const int&,const int&,double*,const int&,const double*,double*,const int&,int&);
     }
 #endif
 
@@ -36,3 +40,7 @@
 
 #define DGETRI LAPACK(dgetri,DGETRI)
 #define DSPTRI LAPACK(dsptri,DSPTRI)
+#define SSPTRF LAPACK(ssptrf,SSPTRF)
+#define SSPTRS LAPACK(ssptrs,SSPTRS)
+#define DGEHRD LAPACK(dgehrd,DGEHRD)
+#define DORGHR LAPACK(dorghr,DORGHR)
@@ -10,9 +10,14 @@ extern "C" {
     void FC_GLOBAL(dsptrf,DSPTRF)(const char&,const int&,double*,int*,int&);
     void FC_GLOBAL(dsptrs,DSPTRS)(const char&,const int&,const int&,double*,int*,double*,const int&,int&);
     void FC_GLOBAL(dsptri,DSPTRI)(const char&,const int&,double*,int*,double*,int&);
+    void FC_GLOBAL(ssptrf,SSPTRF)(const char&,const int&,float*,int*,int&);
+    void FC_GLOBAL(ssptrs,SSPTRS)(const char&,const int&,const int&,float*,int*,float*,const int&,int&);
     void FC_GLOBAL(dpptrf,DPPTRF)(const char&,const int&,double*,int&);
     void FC_GLOBAL(dpptri,DPPTRI)(const char&,const int&,double*,int&);
 
+    void FC_GLOBAL(dgehrd,DGEHRD)(const int&,const int&,const int&,double*,const int&,double*,double*,const int&,int&);
+    void FC_GLOBAL(dorghr,DORGHR)(const int&,const int&,const int&,double*,const int&,const double*,double*,const int&,int&);
+
     void FC_GLOBAL(dgesdd,DGESDD)(const char&,const int&,const int&,double*,const int&,double*,double*,const int&,double*,const int&,double*,const int&,int*,int&);
 }
 
@@ -21,7 +26,12 @@ extern "C" {
 #define DSPTRF FC_GLOBAL(dsptrf,DSPTRF)
 #define DSPTRS FC_GLOBAL(dsptrs,DSPTRS)
 #define DSPTRI FC_GLOBAL(dsptri,DSPTRI)
+#define SSPTRF FC_GLOBAL(ssptrf,SSPTRF)
+#define SSPTRS FC_GLOBAL(ssptrs,SSPTRS)
 #define DPPTRF FC_GLOBAL(dpptrf,DPPTRF)
 #define DPPTRI FC_GLOBAL(dpptri,DPPTRI)
 
+#define DGEHRD FC_GLOBAL(dgehrd,DGEHRD)
+#define DORGHR FC_GLOBAL(dorghr,DORGHR)
+
 #define DGESDD FC_GLOBAL(dgesdd,DGESDD)
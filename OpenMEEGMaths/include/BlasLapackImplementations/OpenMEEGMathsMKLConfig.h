@@ -18,10 +18,14 @@ extern "C" {
 #define DSPTRF(X1,X2,X3,X4,X5)          LAPACK(dsptrf,DSPTRF)(LAPACK_COL_MAJOR,X1,X2,X3,X4)
 #define DSPTRS(X1,X2,X3,X4,X5,X6,X7,X8) LAPACK(dsptrs,DSPTRS)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5,X6,X7)
 #define DSPTRI(X1,X2,X3,X4,X5,X6)       LAPACK(dsptri,DSPTRI)(LAPACK_COL_MAJOR,X1,X2,X3,X4)
+#define SSPTRF(X1,X2,X3,X4,X5)          X5 = LAPACK(ssptrf,SSPTRF)(LAPACK_COL_MAJOR,X1,X2,X3,X4)
+#define SSPTRS(X1,X2,X3,X4,X5,X6,X7,X8) X8 = LAPACK(ssptrs,SSPTRS)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5,X6,X7)
 #define DPPTRF(X1,X2,X3,X4)             LAPACK(dpptrf,DPPTRF)(LAPACK_COL_MAJOR,X1,X2,X3)
 #define DPPTRI(X1,X2,X3,X4)             LAPACK(dpptri,DPPTRI)(LAPACK_COL_MAJOR,X1,X2,X3)
 #define DGETRF(X1,X2,X3,X4,X5)          LAPACK(dgetrf,DGETRF)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5)
 #define DGETRI(X1,X2,X3,X4)             LAPACK(dgetri,DGETRI)(LAPACK_COL_MAJOR,X1,X2,X3,X4)
+#define DGEHRD(X1,X2,X3,X4,X5,X6,X7,X8,X9) X9 = LAPACK(dgehrd,DGEHRD)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5,X6)
+#define DORGHR(X1,X2,X3,X4,X5,X6,X7,X8,X9) X9 = LAPACK(dorghr,DORGHR)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5,X6)
 
 #define DGESDD(X1,X2,X3,X4,X5,X6,X7,X8,X9,X10,X11,X12,X13,X14) LAPACK(dgesdd,DGESDD)(LAPACK_COL_MAJOR,X1,X2,X3,X4,X5,X6,X7,X8,X9,X10)
 
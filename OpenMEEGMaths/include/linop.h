@@ -129,6 +129,11 @@ namespace OpenMEEG {
         LinOpValue(const size_t n,const double* initval): LinOpValue(n) { std::copy(initval,initval+n,&(*this)[0]); }
         LinOpValue(const size_t n,const LinOpValue& v):   LinOpValue(n,&(v[0])) { }
 
+        //  Values owned by someone else (e.g. a memory mapped file), released by the deleter.
+
+        template <typename Deleter>
+        LinOpValue(double* values,Deleter deleter): base(values,deleter) { }
+
         ~LinOpValue() { }
 
         bool empty() const { return static_cast<bool>(*this); }
@@ -55,9 +55,10 @@ namespace OpenMEEG {
 
         // Set S to 0 everywhere, except in the last part of the diag:
 
-        SparseMatrix S(Nc,Nc);
+        SparseMatrix::Builder builder(Nc,Nc);
         for (unsigned i=Nl;i<Nc;++i)
-            S(i,i) = 1.0;
+            builder.insert(i,i,1.0);
+        const SparseMatrix S(builder);
 
         return (V.transpose()*S)*V; // P is a projector: P^2 = P and mat*P*X = 0
     }
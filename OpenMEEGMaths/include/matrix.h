@@ -80,8 +80,9 @@ namespace OpenMEEG {
 
         Matrix(const Vector& v,const size_t M,const size_t N);
 
-        void alloc_data()                       { value = LinOpValue(size());      }
-        void reference_data(const double* vals) { value = LinOpValue(size(),vals); }
+        void alloc_data()                           { value = LinOpValue(size());      }
+        void reference_data(const double* vals)     { value = LinOpValue(size(),vals); }
+        void reference_data(const LinOpValue& vals) { value = vals;                    }
 
         /// \brief Test if Matrix is empty
         /// \return true if Matrix is empty
@@ -416,27 +417,6 @@ namespace OpenMEEG {
     #endif
             return C;
     }
-
-    inline Matrix Matrix::operator*(const SymMatrix &B) const {
-        om_assert(ncol()==B.ncol());
-        Matrix C(nlin(),B.ncol());
-
-    #ifdef HAVE_BLAS
-        Matrix D(B);
-        const int n = sizet_to_int(nlin());
-        const int m = sizet_to_int(D.ncol());
-        const int l = sizet_to_int(C.nlin());
-        DSYMM(CblasRight,CblasUpper,n,m,1.,D.data(),m,data(),n,0.,C.data(),l);
-    #else
-        for (size_t j=0;j<B.ncol();j++)
-            for (size_t i=0;i<ncol();i++) {
-                C(i,j)=0;
-                for (size_t k=0;k<ncol();k++)
-                    C(i,j)+=(*this)(i,k)*B(k,j);
-            }
-    #endif
-            return C;
-    }
     
     inline Matrix Matrix::operator+(const Matrix &B) const {
         om_assert(ncol()==B.ncol());
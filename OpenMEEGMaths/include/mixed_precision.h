@@ -0,0 +1,86 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <OpenMEEGMathsConfig.h>
+#include <vector.h>
+#include <matrix.h>
+#include <symmatrix.h>
+
+namespace OpenMEEG {
+
+    /// \brief Mixed precision solver for symmetric systems.
+    /// The matrix is factorized (Bunch-Kaufman, packed storage) in single precision, which halves
+    /// the memory and bandwidth of the factor. Double precision accuracy is recovered by iterative
+    /// refinement using residuals computed with the original (double precision) matrix, which is
+    /// referenced and must stay available. The peak memory is thus about 12 bytes per packed entry
+    /// (instead of 16 for SymMatrix::solveLin, which factorizes a double precision copy), plus three
+    /// n x nrhs work arrays (the solution, the residuals and their single precision copy).
+
+    class OPENMEEGMATHS_EXPORT MixedPrecisionSolver {
+    public:
+
+        MixedPrecisionSolver(const SymMatrix& A,const unsigned max_iterations=10,const double tolerance=1e-10);
+
+        /// Replace B by the solution X of A*X = B.
+        /// \return true if the refinement converged, false if it did not or if the single precision
+        /// factorization or solve failed (B is left unchanged otherwise).
+
+        bool solve(Matrix& B) const;
+        bool solve(Vector& b) const;
+
+        unsigned iterations() const { return niter; } ///< Number of refinement steps of the last solve.
+        int      status()     const { return info;  } ///< LAPACK status of the single precision factorization.
+
+    private:
+
+        bool solve_single(double* B,const size_t nrhs) const;
+
+        const SymMatrix&      A;
+        const unsigned        max_iter;
+        const double          tol;
+        std::vector<float>    factorization;
+        std::vector<BLAS_INT> pivots;
+        int                   info  = 0;
+        mutable unsigned      niter = 0;
+    };
+}
@@ -40,66 +40,144 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #pragma once
 
 #include <OMassert.H>
-#include <map>
+#include <vector>
 #include <utility>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
 
 #include <linop.h>
 #include <vector.h>
 #include <matrix.h>
 
-// #ifdef WIN32
-// #pragma warning( disable : 4251)    //MSVC warning C4251 : DLL exports of STL templates
-// #endif
-
-#ifdef WIN32
-    template class OPENMEEGMATHS_EXPORT std::map< std::pair< size_t, size_t >, double >;
-#endif
-
 namespace OpenMEEG {
 
     class SymMatrix;
 
+    //  Sparse matrix in compressed sparse row (CSR) format: the column indices and values of line i
+    //  are stored (sorted by column) in the ranges [offsets[i],offsets[i+1]) of columns and values.
+    //  The transpose of a matrix is its compressed sparse column (CSC) representation.
+    //  Matrices are assembled through a Builder which collects (i,j,value) triplets in any order.
+
     class OPENMEEGMATHS_EXPORT SparseMatrix : public LinOp {
 
     public:
 
-        typedef std::map< std::pair< size_t, size_t >, double > Tank;
-        typedef std::map< std::pair< size_t, size_t >, double >::const_iterator const_iterator;
-        typedef std::map< std::pair< size_t, size_t >, double >::iterator iterator;
-
-        SparseMatrix() : LinOp(0,0,SPARSE,2) {};
-        SparseMatrix(const char* fname) : LinOp(0,0,SPARSE,2) { this->load(fname); }
-        SparseMatrix(size_t N,size_t M) : LinOp(N,M,SPARSE,2) {};
-        ~SparseMatrix() {};
-
-        inline double operator()( size_t i, size_t j ) const {
-            om_assert(i < nlin());
-            om_assert(j < ncol());
-            const_iterator it = m_tank.find(std::make_pair(i, j));
-            if (it != m_tank.end()) return it->second;
-            else return 0.0;
-        }
+        typedef std::vector<size_t> Indices;
+        typedef std::vector<double> Values;
+
+        //  Triplet (coordinate) list used to assemble a sparse matrix.
+        //  Triplets can be inserted in any order, duplicate entries are summed.
+
+        class Builder {
+        public:
+
+            Builder(const size_t M,const size_t N): nb_lines(M),nb_cols(N) { }
+
+            size_t nlin() const { return nb_lines; }
+            size_t ncol() const { return nb_cols;  }
+            size_t size() const { return triplets.size(); }
+
+            void reserve(const size_t nz) { triplets.reserve(nz); }
+
+            void insert(const size_t i,const size_t j,const double value) {
+                om_assert(i<nb_lines);
+                om_assert(j<nb_cols);
+                triplets.push_back({ i, j, value });
+            }
+
+        private:
+
+            friend class SparseMatrix;
+
+            struct Triplet {
+                size_t i;
+                size_t j;
+                double value;
+            };
+
+            size_t               nb_lines;
+            size_t               nb_cols;
+            std::vector<Triplet> triplets;
+        };
+
+        //  Iterates over the non-zero entries in line major order. The referenced
+        //  value is ((i,j),value) as for the former associative storage.
+
+        class const_iterator {
+        public:
+
+            typedef std::forward_iterator_tag                  iterator_category;
+            typedef std::pair<std::pair<size_t,size_t>,double> value_type;
+            typedef std::ptrdiff_t                             difference_type;
+            typedef const value_type*                          pointer;
+            typedef const value_type&                          reference;
+
+            const_iterator(): matrix(nullptr),line(0),index(0) { }
+            const_iterator(const SparseMatrix& m,const size_t k): matrix(&m),line(0),index(k) { update(); }
 
-        inline double& operator()( size_t i, size_t j ) {
-            om_assert(i < nlin());
-            om_assert(j < ncol());
-            return m_tank[ std::make_pair( i, j ) ];
+            reference operator*()  const { return entry;  }
+            pointer   operator->() const { return &entry; }
+
+            const_iterator& operator++() { ++index; update(); return *this; }
+            const_iterator  operator++(int) { const_iterator tmp(*this); ++*this; return tmp; }
+
+            bool operator==(const const_iterator& it) const { return index==it.index; }
+            bool operator!=(const const_iterator& it) const { return index!=it.index; }
+
+        private:
+
+            void update() {
+                if (index>=matrix->size())
+                    return;
+                while (matrix->offsets[line+1]<=index)
+                    ++line;
+                entry = value_type(std::make_pair(line,matrix->columns[index]),matrix->vals[index]);
+            }
+
+            const SparseMatrix* matrix;
+            size_t              line;
+            size_t              index;
+            value_type          entry;
+        };
+
+        SparseMatrix(): LinOp(0,0,SPARSE,2),offsets(1,0) { }
+        SparseMatrix(const char* fname): LinOp(0,0,SPARSE,2),offsets(1,0) { this->load(fname); }
+        SparseMatrix(const size_t N,const size_t M): LinOp(N,M,SPARSE,2),offsets(N+1,0) { }
+        SparseMatrix(const Builder& builder);
+
+        //  From CSR arrays (offsets of size N+1, columns sorted in each line).
+
+        SparseMatrix(const size_t N,const size_t M,const Indices& row_offsets,const Indices& column_indices,const Values& values):
+            LinOp(N,M,SPARSE,2),offsets(row_offsets),columns(column_indices),vals(values)
+        {
+            om_assert(offsets.size()==N+1 && columns.size()==vals.size() && offsets[N]==vals.size());
         }
+        ~SparseMatrix() { }
 
-        size_t size() const {
-            return m_tank.size();
+        inline double operator()(const size_t i,const size_t j) const {
+            om_assert(i<nlin());
+            om_assert(j<ncol());
+            const size_t k = find(i,j);
+            return (k!=offsets[i+1] && columns[k]==j) ? vals[k] : 0.0;
         }
 
-        const_iterator begin() const { return m_tank.begin(); }
-        const_iterator end()   const { return m_tank.end(); }
+        size_t size() const { return vals.size(); }
 
-        SparseMatrix transpose() const;
+        const_iterator begin() const { return const_iterator(*this,0);      }
+        const_iterator end()   const { return const_iterator(*this,size()); }
 
-        const Tank& tank() const {return m_tank;}
+        //  Raw CSR storage.
 
-        void set( double t);
+        const Indices& row_offsets()    const { return offsets; }
+        const Indices& column_indices() const { return columns; }
+        const Values&  values()         const { return vals;    }
+
+        SparseMatrix transpose() const;
+
+        void set(double t);
         Vector getlin(size_t i) const;
-        void setlin(Vector v, size_t i);
+        void setlin(const Vector& v,size_t i);
 
         void save(const char *filename) const;
         void load(const char *filename);
@@ -118,24 +196,33 @@ namespace OpenMEEG {
 
     private:
 
-        Tank m_tank;
+        //  Position of the first entry of line i whose column is not less than j.
+
+        size_t find(const size_t i,const size_t j) const {
+            const Indices::const_iterator first = columns.begin()+offsets[i];
+            const Indices::const_iterator last  = columns.begin()+offsets[i+1];
+            return std::lower_bound(first,last,j)-columns.begin();
+        }
+
+        Indices offsets;
+        Indices columns;
+        Values  vals;
     };
 
     inline Vector SparseMatrix::getlin(size_t i) const {
         om_assert(i<nlin());
         Vector v(ncol());
-        for (size_t j=0;j<ncol();j++){
-            const_iterator it = m_tank.find(std::make_pair(i, j));
-            if (it != m_tank.end()) v(j)=it->second;
-            else v(j)=0.0;
-        }
+        v.set(0.0);
+        for (size_t k=offsets[i];k<offsets[i+1];++k)
+            v(columns[k]) = vals[k];
         return v;
     }
 
-    inline void SparseMatrix::setlin(Vector v, size_t i) {
-        om_assert(i<nlin());
-        for (size_t j=0;j<v.nlin();j++){
-            (*this)(i,j) = v(j);
-        }
+    inline std::ostream& operator<<(std::ostream& f,const SparseMatrix& M) {
+        f << M.nlin() << " " << M.ncol() << std::endl;
+        f << M.size() << std::endl;
+        for (SparseMatrix::const_iterator it=M.begin();it!=M.end();++it)
+            f << it->first.first << "\t" << it->first.second << "\t" << it->second << std::endl;
+        return f;
     }
 }
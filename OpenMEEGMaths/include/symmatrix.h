@@ -42,6 +42,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 #include <vector.h>
 #include <linop.h>
@@ -76,6 +77,7 @@ namespace OpenMEEG {
 
         void alloc_data() { value = LinOpValue(size()); }
         void reference_data(const double* array) { value = LinOpValue(size(),array); }
+        void reference_data(const LinOpValue& array) { value = array; }
 
         bool empty() const { return value.empty(); }
         void set(double x) ;
@@ -89,6 +91,7 @@ namespace OpenMEEG {
         SymMatrix submat(size_t istart, size_t iend) const;
         Vector    getlin(size_t i) const;
         void      setlin(size_t i, const Vector& v);
+        Matrix    getlines(const std::vector<size_t>& lines) const;
         Vector    solveLin(const Vector &B) const;
         void      solveLin(Vector* B,const int nbvect);
         Matrix    solveLin(Matrix& B) const;
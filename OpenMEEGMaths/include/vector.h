@@ -68,6 +68,7 @@ namespace OpenMEEG {
 
         void alloc_data() { value = LinOpValue(size()); }
         void reference_data(const double* array) { value = LinOpValue(size(),array); }
+        void reference_data(const LinOpValue& array) { value = array; }
 
         size_t size() const { return nlin(); }
 
@@ -124,7 +124,6 @@ namespace OpenMEEG {
         size_t mini = std::min(nlin(),ncol());
         size_t maxi = std::max(nlin(),ncol());
         U = Matrix(nlin(),nlin()); U.set(0);
-        S = SparseMatrix(nlin(),ncol());
         V = Matrix(ncol(),ncol()); V.set(0);
         double *s = new double[mini];
         // int lwork = 4 *mini*mini + maxi + 9*mini; 
@@ -138,7 +137,9 @@ namespace OpenMEEG {
         } else { // only first min(m,n)
             DGESDD('S',sizet_to_int(nlin()),sizet_to_int(ncol()),cpy.data(),sizet_to_int(nlin()),s,U.data(),sizet_to_int(U.nlin()),V.data(),sizet_to_int(V.nlin()),work,lwork,iwork,Info);
         }
-        for ( size_t i = 0; i < mini; ++i) S(i, i) = s[i];
+        SparseMatrix::Builder diagonal(nlin(),ncol());
+        for ( size_t i = 0; i < mini; ++i) diagonal.insert(i,i,s[i]);
+        S = SparseMatrix(diagonal);
         delete[] s;
         delete[] work;
         delete[] iwork;
@@ -154,17 +155,29 @@ namespace OpenMEEG {
 
     Matrix Matrix::operator *(const SparseMatrix &mat) const
     {
+        // Column j of the result combines the columns of *this selected by line j of the transpose of mat.
+
         om_assert(ncol()==mat.nlin());
         Matrix out(nlin(),mat.ncol());
         out.set(0.0);
 
-        SparseMatrix::const_iterator it;
-        for(it = mat.begin(); it != mat.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            double val = it->second;
-            for(size_t k = 0; k < nlin(); ++k) {
-                out(k,j) += this->operator()(k,i) * val;
+        const SparseMatrix& matt = mat.transpose();
+        const SparseMatrix::Indices& offsets = matt.row_offsets();
+        const SparseMatrix::Indices& columns = matt.column_indices();
+        const SparseMatrix::Values&  values  = matt.values();
+
+        #pragma omp parallel for
+        #ifdef OPENMP_UNSIGNED
+        for (unsigned j=0;j<matt.nlin();++j) {
+        #else
+        for (int j=0;j<static_cast<int>(matt.nlin());++j) {
+        #endif
+            double* col = out.data()+j*nlin();
+            for (size_t k=offsets[j];k<offsets[j+1];++k) {
+                const double  val = values[k];
+                const double* src = data()+columns[k]*nlin();
+                for (size_t i=0;i<nlin();++i)
+                    col[i] += val*src[i];
             }
         }
         return out;
@@ -0,0 +1,146 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "OpenMEEGMathsConfig.h"
+#include "mixed_precision.h"
+
+namespace OpenMEEG {
+
+    MixedPrecisionSolver::MixedPrecisionSolver(const SymMatrix& M,const unsigned max_iterations,const double tolerance):
+        A(M),max_iter(max_iterations),tol(tolerance),factorization(M.data(),M.data()+M.size()),pivots(M.nlin())
+    {
+    #ifdef HAVE_LAPACK
+        // Bunch Kaufman Factorization in single precision. A failure (e.g. a matrix which is singular
+        // in single precision) is recorded and reported by solve().
+        SSPTRF('U',sizet_to_int(A.nlin()),factorization.data(),pivots.data(),info);
+    #else
+        std::cerr << "MixedPrecisionSolver not defined without LAPACK" << std::endl;
+        exit(1);
+    #endif
+    }
+
+    // Solve in single precision (in place). The columns are scaled to avoid underflows
+    // of the (small) residuals when they are converted to float.
+
+    bool MixedPrecisionSolver::solve_single(double* B,const size_t nrhs) const {
+    #ifdef HAVE_LAPACK
+        const size_t n = A.nlin();
+        std::vector<float>  F(n*nrhs);
+        std::vector<double> scales(nrhs);
+        for (size_t j=0;j<nrhs;++j) {
+            double* col = B+j*n;
+            const double scale = *std::max_element(col,col+n,[](const double a,const double b) { return std::abs(a)<std::abs(b); });
+            scales[j] = (scale==0.0) ? 1.0 : std::abs(scale);
+            for (size_t i=0;i<n;++i)
+                F[i+j*n] = static_cast<float>(col[i]/scales[j]);
+        }
+        int Info = 0;
+        SSPTRS('U',sizet_to_int(n),sizet_to_int(nrhs),const_cast<float*>(factorization.data()),const_cast<BLAS_INT*>(pivots.data()),F.data(),sizet_to_int(n),Info);
+        if (Info!=0)
+            return false;
+        for (size_t j=0;j<nrhs;++j)
+            for (size_t i=0;i<n;++i)
+                B[i+j*n] = scales[j]*F[i+j*n];
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    bool MixedPrecisionSolver::solve(Matrix& B) const {
+        om_assert(B.nlin()==A.nlin());
+        const size_t n    = A.nlin();
+        const size_t nrhs = B.ncol();
+
+        niter = 0;
+        if (info!=0)
+            return false;
+
+        Matrix X(B,DEEP_COPY);
+        if (!solve_single(X.data(),nrhs))
+            return false;
+
+        // Iterative refinement: R = B-A*X, A*D = R (single precision), X += D.
+
+        Matrix R(n,nrhs);
+        for (niter=1;niter<=max_iter;++niter) {
+            #pragma omp parallel for
+            #ifdef OPENMP_UNSIGNED
+            for (unsigned j=0;j<nrhs;++j) {
+            #else
+            for (int j=0;j<static_cast<int>(nrhs);++j) {
+            #endif
+                std::copy(B.data()+j*n,B.data()+(j+1)*n,R.data()+j*n);
+                DSPMV(CblasUpper,sizet_to_int(n),-1.,A.data(),X.data()+j*n,1,1.,R.data()+j*n,1);
+            }
+            if (!solve_single(R.data(),nrhs))
+                return false;
+
+            bool converged = true;
+            for (size_t j=0;j<nrhs;++j) {
+                double normx = 0.0;
+                double normd = 0.0;
+                for (size_t i=0;i<n;++i) {
+                    X(i,j) += R(i,j);
+                    normx = std::max(normx,std::abs(X(i,j)));
+                    normd = std::max(normd,std::abs(R(i,j)));
+                }
+                if (!std::isfinite(normd) || normd>tol*normx)
+                    converged = false;
+            }
+
+            if (converged) {
+                B = X;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool MixedPrecisionSolver::solve(Vector& b) const {
+        Matrix B(b,b.size(),1);
+        if (!solve(B))
+            return false;
+        b = B.getcol(0);
+        return true;
+    }
+}
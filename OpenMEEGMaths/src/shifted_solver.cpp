@@ -0,0 +1,138 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "OpenMEEGMathsConfig.h"
+#include "shifted_solver.h"
+
+namespace OpenMEEG {
+
+    ShiftedSolver::ShiftedSolver(const Matrix& K,const Matrix& B): Q(K,DEEP_COPY),Ht(K.nlin(),K.ncol()) {
+        om_assert(K.nlin()==K.ncol());
+        om_assert(B.nlin()==K.nlin());
+    #ifdef HAVE_LAPACK
+        const BLAS_INT n = sizet_to_int(K.nlin());
+        if (n==0) {
+            QtB = B;
+            return;
+        }
+
+        // Householder reduction to the Hessenberg form: the reflectors are stored below the
+        // sub-diagonal of Q and are then expanded into the orthogonal matrix itself.
+
+        std::vector<double> tau(n);
+        std::vector<double> work(64*n);
+        int Info = 0;
+        DGEHRD(n,1,n,Q.data(),n,tau.data(),work.data(),sizet_to_int(work.size()),Info);
+        om_assert(Info==0);
+
+        Ht.set(0.0);
+        for (size_t j=0; j<Ht.nlin(); ++j)
+            for (size_t i=0; i<=std::min(j+1,Ht.ncol()-1); ++i)
+                Ht(j,i) = Q(i,j);
+
+        DORGHR(n,1,n,Q.data(),n,tau.data(),work.data(),sizet_to_int(work.size()),Info);
+        om_assert(Info==0);
+
+        QtB = Q.tmult(B);
+    #else
+        std::cerr << "ShiftedSolver not defined without LAPACK" << std::endl;
+        exit(1);
+    #endif
+    }
+
+    Matrix ShiftedSolver::solve(const double t) const {
+        const size_t n    = size();
+        const size_t nrhs = QtB.ncol();
+
+        //  Line i of M = I+t H is the column i of Mt, its non zero elements are in [i-1,n).
+
+        Matrix Mt(Ht,DEEP_COPY);
+        for (size_t i=0; i<n; ++i) {
+            double* line = Mt.data()+i*n;
+            for (size_t j=((i==0) ? 0 : i-1); j<n; ++j)
+                line[j] *= t;
+            line[i] += 1.0;
+        }
+
+        Matrix X(QtB,DEEP_COPY);
+
+        // Gaussian elimination of the sub-diagonal, with partial pivoting between adjacent lines.
+
+        for (size_t k=0; k+1<n; ++k) {
+            double* line  = Mt.data()+k*n;
+            double* next  = line+n;
+            if (std::abs(next[k])>std::abs(line[k])) {
+                std::swap_ranges(line+k,line+n,next+k);
+                for (size_t j=0; j<nrhs; ++j)
+                    std::swap(X(k,j),X(k+1,j));
+            }
+            if (next[k]==0.0)
+                continue;
+            if (line[k]==0.0)
+                throw std::invalid_argument("ShiftedSolver: the shifted matrix is singular.");
+            const double l = next[k]/line[k];
+            for (size_t j=k+1; j<n; ++j)
+                next[j] -= l*line[j];
+            for (size_t j=0; j<nrhs; ++j)
+                X(k+1,j) -= l*X(k,j);
+        }
+
+        // Back substitution with the upper triangular factor.
+
+        for (size_t k=n; k-->0;) {
+            const double* line = Mt.data()+k*n;
+            if (line[k]==0.0)
+                throw std::invalid_argument("ShiftedSolver: the shifted matrix is singular.");
+            for (size_t j=0; j<nrhs; ++j) {
+                double* x = X.data()+j*n;
+                double sum = x[k];
+                for (size_t i=k+1; i<n; ++i)
+                    sum -= line[i]*x[i];
+                x[k] = sum/line[k];
+            }
+        }
+
+        return Q*X;
+    }
+}
@@ -37,66 +37,157 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <numeric>
+
 #include "sparse_matrix.h"
 #include "symmatrix.h"
 
 namespace OpenMEEG {
 
+    SparseMatrix::SparseMatrix(const Builder& builder):
+        LinOp(builder.nlin(),builder.ncol(),SPARSE,2),offsets(builder.nlin()+1,0)
+    {
+        // Bucket the triplets by line (counting sort, which preserves the insertion order).
+
+        const size_t nz = builder.size();
+        Indices cols(nz);
+        Values  values(nz);
+        for (const auto& triplet : builder.triplets)
+            ++offsets[triplet.i+1];
+        std::partial_sum(offsets.begin(),offsets.end(),offsets.begin());
+
+        Indices position(offsets.begin(),offsets.end()-1);
+        for (const auto& triplet : builder.triplets) {
+            const size_t k = position[triplet.i]++;
+            cols[k]   = triplet.j;
+            values[k] = triplet.value;
+        }
+
+        // Sort each line by column and sum duplicate entries.
+
+        columns.reserve(nz);
+        vals.reserve(nz);
+        Indices perm;
+        size_t start = 0;
+        for (unsigned i=0;i<nlin();++i) {
+            const size_t first = offsets[i];
+            const size_t last  = offsets[i+1];
+            perm.resize(last-first);
+            std::iota(perm.begin(),perm.end(),first);
+            std::stable_sort(perm.begin(),perm.end(),[&cols](const size_t k1,const size_t k2) { return cols[k1]<cols[k2]; });
+            for (const auto& k : perm)
+                if (columns.size()>start && columns.back()==cols[k]) {
+                    vals.back() += values[k];
+                } else {
+                    columns.push_back(cols[k]);
+                    vals.push_back(values[k]);
+                }
+            offsets[i] = start;
+            start = columns.size();
+        }
+        offsets[nlin()] = start;
+    }
+
     double SparseMatrix::frobenius_norm() const {
         double d = 0.;
-        for ( const_iterator it = m_tank.begin() ; it != m_tank.end(); ++it) {
-            d += std::pow(it->second,2);
-        }
+        for (const auto& val : vals)
+            d += val*val;
         return sqrt(d);
     }
 
     Vector SparseMatrix::operator*(const Vector &x) const
     {
+        om_assert(ncol()==x.nlin());
         Vector ret(nlin());
-        ret.set(0);
-
-        Tank::const_iterator it;
-        for(it = m_tank.begin(); it != m_tank.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            double val = it->second;
-            ret(i) += val * x(j);
+
+        #pragma omp parallel for
+        #ifdef OPENMP_UNSIGNED
+        for (unsigned i=0;i<nlin();++i) {
+        #else
+        for (int i=0;i<static_cast<int>(nlin());++i) {
+        #endif
+            double sum = 0.0;
+            for (size_t k=offsets[i];k<offsets[i+1];++k)
+                sum += vals[k]*x(columns[k]);
+            ret(i) = sum;
         }
 
         return ret;
     }
 
+    //  Only the lines of mat selected by the non-zero columns contribute to the product
+    //  (e.g. a few hundred lines of an inverse head matrix for EEG). These lines are gathered
+    //  from the packed storage and combined column by column. When too many lines are
+    //  selected, the gathered block would exceed the result size and mat is accessed directly.
+
     Matrix SparseMatrix::operator*(const SymMatrix &mat) const
     {
         om_assert(ncol()==mat.nlin());
         Matrix out(nlin(),mat.ncol());
-        out.set(0.0);
-
-        Tank::const_iterator it;
-        for(it = m_tank.begin(); it != m_tank.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            double val = it->second;
-            for(size_t k = 0; k < mat.ncol(); ++k) {
-                out(i,k) += val * mat(j,k);
+
+        std::vector<size_t> lines(columns);
+        std::sort(lines.begin(),lines.end());
+        lines.erase(std::unique(lines.begin(),lines.end()),lines.end());
+
+        if (lines.size()>4*nlin()) {
+            #pragma omp parallel for
+            #ifdef OPENMP_UNSIGNED
+            for (unsigned j=0;j<mat.ncol();++j) {
+            #else
+            for (int j=0;j<static_cast<int>(mat.ncol());++j) {
+            #endif
+                for (size_t i=0;i<nlin();++i) {
+                    double sum = 0.0;
+                    for (size_t k=offsets[i];k<offsets[i+1];++k)
+                        sum += vals[k]*mat(columns[k],j);
+                    out(i,j) = sum;
+                }
+            }
+            return out;
+        }
+
+        const Matrix& rows = mat.getlines(lines);
+        Indices position(size());
+        for (size_t k=0;k<size();++k)
+            position[k] = std::lower_bound(lines.begin(),lines.end(),columns[k])-lines.begin();
+
+        #pragma omp parallel for
+        #ifdef OPENMP_UNSIGNED
+        for (unsigned j=0;j<mat.ncol();++j) {
+        #else
+        for (int j=0;j<static_cast<int>(mat.ncol());++j) {
+        #endif
+            const double* col = rows.data()+j*rows.nlin();
+            for (size_t i=0;i<nlin();++i) {
+                double sum = 0.0;
+                for (size_t k=offsets[i];k<offsets[i+1];++k)
+                    sum += vals[k]*col[position[k]];
+                out(i,j) = sum;
             }
         }
 
         return out;
     }
 
+    //  Computed column by column so that the dense operand and the result are accessed contiguously.
+
     Matrix SparseMatrix::operator*(const Matrix &mat) const
     {
         om_assert(ncol()==mat.nlin());
         Matrix out(nlin(),mat.ncol());
-        out.set(0.0);
-
-        for( Tank::const_iterator it = m_tank.begin(); it != m_tank.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            double val = it->second;
-            for ( size_t k = 0; k < mat.ncol(); ++k) {
-                out(i, k) += val * mat(j, k);
+
+        #pragma omp parallel for
+        #ifdef OPENMP_UNSIGNED
+        for (unsigned j=0;j<mat.ncol();++j) {
+        #else
+        for (int j=0;j<static_cast<int>(mat.ncol());++j) {
+        #endif
+            const double* col = mat.data()+j*mat.nlin();
+            for (size_t i=0;i<nlin();++i) {
+                double sum = 0.0;
+                for (size_t k=offsets[i];k<offsets[i+1];++k)
+                    sum += vals[k]*col[columns[k]];
+                out(i,j) = sum;
             }
         }
 
@@ -105,18 +196,35 @@ namespace OpenMEEG {
 
     SparseMatrix SparseMatrix::operator*(const SparseMatrix &mat) const
     {
-        // fast enough ?
-        om_assert(ncol() == mat.nlin());
-        SparseMatrix out(nlin(), mat.ncol());
-
-        for ( Tank::const_iterator it1 = m_tank.begin(); it1 != m_tank.end(); ++it1) {
-            size_t i = it1->first.first;
-            size_t j = it1->first.second;
-            for ( Tank::const_iterator it2 = mat.begin(); it2 != mat.end(); ++it2) {
-                if ( it2->first.first == j ) {
-                    out(i, it2->first.second) += it1->second * it2->second;
+        // Row by row product with a dense accumulator (Gustavson's algorithm).
+
+        om_assert(ncol()==mat.nlin());
+        SparseMatrix out(nlin(),mat.ncol());
+
+        const size_t none = static_cast<size_t>(-1);
+        Values  acc(mat.ncol(),0.0);
+        Indices marker(mat.ncol(),none);
+        Indices line;
+        for (unsigned i=0;i<nlin();++i) {
+            line.clear();
+            for (size_t k=offsets[i];k<offsets[i+1];++k) {
+                const size_t j = columns[k];
+                for (size_t l=mat.offsets[j];l<mat.offsets[j+1];++l) {
+                    const size_t c = mat.columns[l];
+                    if (marker[c]!=i) {
+                        marker[c] = i;
+                        acc[c]    = 0.0;
+                        line.push_back(c);
+                    }
+                    acc[c] += vals[k]*mat.vals[l];
                 }
             }
+            std::sort(line.begin(),line.end());
+            for (const auto& c : line) {
+                out.columns.push_back(c);
+                out.vals.push_back(acc[c]);
+            }
+            out.offsets[i+1] = out.columns.size();
         }
         return out;
     }
@@ -125,53 +233,86 @@ namespace OpenMEEG {
     {
         om_assert(nlin() == mat.nlin() && ncol() == mat.ncol());
         SparseMatrix out(nlin(), ncol());
-
-        for ( Tank::const_iterator it = m_tank.begin(); it != m_tank.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            out(i, j) += it->second;
-        }
-        for ( Tank::const_iterator it = mat.begin(); it != mat.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            out(i, j) += it->second;
+        out.columns.reserve(size()+mat.size());
+        out.vals.reserve(size()+mat.size());
+
+        for (unsigned i=0;i<nlin();++i) {
+            size_t k1 = offsets[i];
+            size_t k2 = mat.offsets[i];
+            while (k1<offsets[i+1] || k2<mat.offsets[i+1]) {
+                if (k2==mat.offsets[i+1] || (k1<offsets[i+1] && columns[k1]<mat.columns[k2])) {
+                    out.columns.push_back(columns[k1]);
+                    out.vals.push_back(vals[k1++]);
+                } else if (k1==offsets[i+1] || mat.columns[k2]<columns[k1]) {
+                    out.columns.push_back(mat.columns[k2]);
+                    out.vals.push_back(mat.vals[k2++]);
+                } else {
+                    out.columns.push_back(columns[k1]);
+                    out.vals.push_back(vals[k1++]+mat.vals[k2++]);
+                }
+            }
+            out.offsets[i+1] = out.columns.size();
         }
         return out;
     }
 
     SparseMatrix SparseMatrix::transpose() const {
         SparseMatrix tsp(ncol(),nlin());
-        const_iterator it;
-        for(it = m_tank.begin(); it != m_tank.end(); ++it) {
-            size_t i = it->first.first;
-            size_t j = it->first.second;
-            tsp(j,i) = it->second;
-        }
+        tsp.columns.resize(size());
+        tsp.vals.resize(size());
+
+        for (const auto& j : columns)
+            ++tsp.offsets[j+1];
+        std::partial_sum(tsp.offsets.begin(),tsp.offsets.end(),tsp.offsets.begin());
+
+        Indices position(tsp.offsets.begin(),tsp.offsets.end()-1);
+        for (size_t i=0;i<nlin();++i)
+            for (size_t k=offsets[i];k<offsets[i+1];++k) {
+                const size_t l = position[columns[k]]++;
+                tsp.columns[l] = i;
+                tsp.vals[l]    = vals[k];
+            }
         return tsp;
     }
 
     void SparseMatrix::set(double d) {
-        for( iterator it = m_tank.begin(); it != m_tank.end(); ++it) {
-            it->second = d;
-        }
+        std::fill(vals.begin(),vals.end(),d);
+    }
+
+    void SparseMatrix::setlin(const Vector& v,size_t i) {
+        om_assert(i<nlin());
+        om_assert(v.nlin()==ncol());
+
+        const size_t first = offsets[i];
+        const size_t last  = offsets[i+1];
+        columns.erase(columns.begin()+first,columns.begin()+last);
+        vals.erase(vals.begin()+first,vals.begin()+last);
+
+        Indices cols(ncol());
+        std::iota(cols.begin(),cols.end(),0);
+        columns.insert(columns.begin()+first,cols.begin(),cols.end());
+        vals.insert(vals.begin()+first,v.data(),v.data()+ncol());
+
+        for (size_t l=i+1;l<offsets.size();++l)
+            offsets[l] = offsets[l]-(last-first)+ncol();
     }
 
     void SparseMatrix::info() const {
-        if ((nlin() == 0) || (ncol() == 0) || m_tank.empty()) {
+        if ((nlin() == 0) || (ncol() == 0) || vals.empty()) {
             std::cout << "Matrix Empty" << std::endl;
             return;
         }
 
         std::cout << "Dimensions : " << nlin() << " x " << ncol() << std::endl;
 
-        double minv = m_tank.begin()->second;
-        double maxv = m_tank.begin()->second;
+        double minv = vals.front();
+        double maxv = vals.front();
         size_t mini = 0;
         size_t maxi = 0;
         size_t minj = 0;
         size_t maxj = 0;
 
-        for (Tank::const_iterator it=m_tank.begin();it!=m_tank.end();++it) {
+        for (const_iterator it=begin();it!=end();++it) {
             if (minv>it->second) {
                 minv = it->second;
                 mini = it->first.first;
@@ -188,7 +329,7 @@ namespace OpenMEEG {
         std::cout << "First Values" << std::endl;
 
         size_t cnt = 0;
-        for(Tank::const_iterator it = m_tank.begin(); it != m_tank.end() && cnt < 5; ++it) {
+        for (const_iterator it=begin(); it!=end() && cnt<5; ++it) {
             std::cout << "(" << it->first.first << "," << it->first.second << ") " << it->second << std::endl;
             cnt++;
         }
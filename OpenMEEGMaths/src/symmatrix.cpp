@@ -41,6 +41,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <cmath>
 #include <cstdlib>
 #include <algorithm>
+#include <vector>
 
 #include "OpenMEEGMathsConfig.h"
 #include "matrix.h"
@@ -48,6 +49,57 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 namespace OpenMEEG {
 
+#ifdef HAVE_BLAS
+    namespace Details {
+
+        //  Products of a packed (upper) symmetric matrix with dense matrices are computed by blocks
+        //  of panel_width columns. Each block is unpacked on the fly in a panel holding the lines
+        //  [0,j1) of the columns [j0,j1), so that only one panel is allocated besides the operands.
+
+        static const size_t panel_width = 256;
+
+        static void unpack_panel(const double* S,const size_t j0,const size_t j1,double* P,const size_t ld) {
+            for (size_t j=j0;j<j1;++j)
+                std::copy(S+j*(j+1)/2,S+j*(j+1)/2+j+1,P+(j-j0)*ld);
+            for (size_t j=j0;j<j1;++j)
+                for (size_t i=j+1;i<j1;++i)
+                    P[i+(j-j0)*ld] = P[j+(i-j0)*ld];
+        }
+
+        //  C += S*B with S of size n x n and B of size n x m.
+
+        static void packed_symm_left(const double* S,const size_t n,const double* B,const size_t ldb,const size_t m,double* C,const size_t ldc) {
+            std::vector<double> P(n*std::min(n,panel_width));
+            for (size_t j0=0;j0<n;j0+=panel_width) {
+                const size_t j1 = std::min(n,j0+panel_width);
+                const size_t w  = j1-j0;
+                unpack_panel(S,j0,j1,P.data(),j1);
+                DGEMM(CblasNoTrans,CblasNoTrans,sizet_to_int(j1),sizet_to_int(m),sizet_to_int(w),
+                      1.,P.data(),sizet_to_int(j1),B+j0,sizet_to_int(ldb),1.,C,sizet_to_int(ldc));
+                if (j0!=0)
+                    DGEMM(CblasTrans,CblasNoTrans,sizet_to_int(w),sizet_to_int(m),sizet_to_int(j0),
+                          1.,P.data(),sizet_to_int(j1),B,sizet_to_int(ldb),1.,C+j0,sizet_to_int(ldc));
+            }
+        }
+
+        //  C += B*S with B of size l x n and S of size n x n.
+
+        static void packed_symm_right(const double* S,const size_t n,const double* B,const size_t ldb,const size_t l,double* C,const size_t ldc) {
+            std::vector<double> P(n*std::min(n,panel_width));
+            for (size_t j0=0;j0<n;j0+=panel_width) {
+                const size_t j1 = std::min(n,j0+panel_width);
+                const size_t w  = j1-j0;
+                unpack_panel(S,j0,j1,P.data(),j1);
+                DGEMM(CblasNoTrans,CblasNoTrans,sizet_to_int(l),sizet_to_int(w),sizet_to_int(j1),
+                      1.,B,sizet_to_int(ldb),P.data(),sizet_to_int(j1),1.,C+j0*ldc,sizet_to_int(ldc));
+                if (j0!=0)
+                    DGEMM(CblasNoTrans,CblasTrans,sizet_to_int(l),sizet_to_int(j0),sizet_to_int(w),
+                          1.,B+j0*ldb,sizet_to_int(ldb),P.data(),sizet_to_int(j1),1.,C,sizet_to_int(ldc));
+            }
+        }
+    }
+#endif
+
     const SymMatrix& SymMatrix::operator=(const double d) {
         for(size_t i=0;i<size();i++) data()[i]=d;
         return *this;
@@ -109,15 +161,57 @@ namespace OpenMEEG {
         return mat;
     }
 
+    //  Gather the given lines in a single sequential pass over the packed storage.
+    //  Packed column k holds the entries (0..k,k), which provide the entries of
+    //  the selected lines i<=k in column k and, when k is selected, the first k+1
+    //  entries of line k.
+
+    Matrix SymMatrix::getlines(const std::vector<size_t>& lines) const {
+        const size_t none = static_cast<size_t>(-1);
+        std::vector<size_t> position(nlin(),none);
+        for (size_t l=0;l<lines.size();++l) {
+            om_assert(lines[l]<nlin());
+            position[lines[l]] = l;
+        }
+
+        const size_t nl = lines.size();
+        Matrix result(nl,nlin());
+        for (size_t k=0;k<nlin();++k) {
+            const double* col = data()+k*(k+1)/2;
+            double* res = result.data()+k*nl;
+            for (size_t l=0;l<nl;++l)
+                if (lines[l]<=k)
+                    res[l] = col[lines[l]];
+            if (position[k]!=none)
+                for (size_t j=0;j<k;++j)
+                    result(position[k],j) = col[j];
+        }
+        return result;
+    }
+
     SymMatrix SymMatrix::operator*(const SymMatrix &m) const
     {
         om_assert(nlin()==m.nlin());
     #ifdef HAVE_BLAS
-        Matrix D(*this);
-        Matrix B(m);
-        Matrix C(nlin(),nlin());
-        DSYMM(CblasLeft,CblasUpper,sizet_to_int(nlin()),sizet_to_int(B.ncol()),1.,D.data(),sizet_to_int(D.ncol()),B.data(),sizet_to_int(B.nlin()),0,C.data(),sizet_to_int(C.nlin()));
-        return SymMatrix(C);
+        //  The result is computed by blocks of columns: each block of m is unpacked in a dense panel,
+        //  multiplied by *this and the upper part of the product is stored in C.
+
+        const size_t n = nlin();
+        SymMatrix C(n);
+        std::vector<double> B(n*std::min(n,Details::panel_width));
+        std::vector<double> T(B.size());
+        for (size_t j0=0;j0<n;j0+=Details::panel_width) {
+            const size_t j1 = std::min(n,j0+Details::panel_width);
+            Details::unpack_panel(m.data(),j0,j1,B.data(),n);
+            for (size_t i=j1;i<n;++i)
+                for (size_t j=j0;j<j1;++j)
+                    B[i+(j-j0)*n] = m.data()[j+i*(i+1)/2];
+            std::fill(T.begin(),T.end(),0.0);
+            Details::packed_symm_left(data(),n,B.data(),n,j1-j0,T.data(),n);
+            for (size_t j=j0;j<j1;++j)
+                std::copy(T.data()+(j-j0)*n,T.data()+(j-j0)*n+j+1,C.data()+j*(j+1)/2);
+        }
+        return C;
     #else
         SymMatrix C(nlin());
         for ( size_t j = 0; j < m.ncol(); ++j) {
@@ -137,8 +231,8 @@ namespace OpenMEEG {
         om_assert(ncol()==B.nlin());
         Matrix C(nlin(),B.ncol());
     #ifdef HAVE_BLAS
-        Matrix D(*this);
-        DSYMM(CblasLeft,CblasUpper, sizet_to_int(nlin()), sizet_to_int(B.ncol()), 1. , D.data(), sizet_to_int(D.ncol()), B.data(), sizet_to_int(B.nlin()), 0, C.data(),sizet_to_int(C.nlin()));
+        C.set(0.0);
+        Details::packed_symm_left(data(),nlin(),B.data(),B.nlin(),B.ncol(),C.data(),C.nlin());
     #else
         for ( size_t j = 0; j < B.ncol(); ++j) {
             for ( size_t i = 0; i < ncol(); ++i) {
@@ -152,6 +246,23 @@ namespace OpenMEEG {
         return C;
     }
 
+    Matrix Matrix::operator*(const SymMatrix &B) const {
+        om_assert(ncol()==B.ncol());
+        Matrix C(nlin(),B.ncol());
+    #ifdef HAVE_BLAS
+        C.set(0.0);
+        Details::packed_symm_right(B.data(),B.nlin(),data(),nlin(),nlin(),C.data(),C.nlin());
+    #else
+        for (size_t j=0;j<B.ncol();j++)
+            for (size_t i=0;i<nlin();i++) {
+                C(i,j)=0;
+                for (size_t k=0;k<ncol();k++)
+                    C(i,j)+=(*this)(i,k)*B(k,j);
+            }
+    #endif
+        return C;
+    }
+
     Matrix SymMatrix::solveLin(Matrix &RHS) const {
     #ifdef HAVE_LAPACK
         SymMatrix A(*this,DEEP_COPY);
@@ -38,11 +38,13 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <cmath>
+#include <fstream>
 #include <iostream>
 
 #include <OpenMEEGMathsConfig.h>
 #include <matrix.h>
 #include <sparse_matrix.h>
+#include <MathsIO.H>
 #include <generic_test.hpp>
 
 int main () {
@@ -65,6 +67,33 @@ int main () {
     std::cout << "Matrice Q : " << std::endl;
     Q.info();
 
+    // Text files with layouts not handled by the fast parser (signs, spacing, extra values).
+
+    {
+        std::ofstream os("full_layout.txt");
+        os << "1.5 -2 3e2\n4   5\t.25\r\n+0.5 1e-3 2 9\n";
+    }
+    Matrix L("full_layout.txt");
+    const double expected[] = { 1.5, 4.0, 0.5, -2.0, 5.0, 1e-3, 300.0, 0.25, 2.0 };
+    for (unsigned k=0;k<9;++k)
+        if (L.data()[k]!=expected[k]) {
+            std::cerr << "Error: text matrix parsing is WRONG" << std::endl;
+            exit(1);
+        }
+
+    // Block reads from files.
+
+    for (const std::string suffix : { "bin", "omb", "mat" }) {
+        const std::string name = "full_block."+suffix;
+        M.save(name);
+        Matrix B;
+        maths::read_block(name.c_str(),B,1,3,2,2);
+        if ((B-M.submat(1,3,2,2)).frobenius_norm()!=0.0) {
+            std::cerr << "Error: block read is WRONG for " << name << std::endl;
+            exit(1);
+        }
+    }
+
     Matrix M1 = M;
     M1.insertmat(3,1,Q); // insert submatrix
     if (std::abs((M1-M).frobenius_norm()) > 1e-10) {
@@ -65,6 +65,12 @@ void genericTest(const std::string& basename, T &M) {
     M.load(binname);
     M.info();
 
+    std::cout << std::endl << "OMB :" << std::endl;
+    const std::string ombname = basename+".omb";
+    M.save(ombname);
+    M.load(ombname);
+    M.info();
+
     std::cout << std::endl << "TXT :" << std::endl;
     const std::string txtname = basename+".txt";
     M.save(txtname);
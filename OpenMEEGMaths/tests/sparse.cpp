@@ -40,6 +40,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <iostream>
 
 #include <OpenMEEGMathsConfig.h>
+#include <symmatrix.h>
 #include <sparse_matrix.h>
 #include <fast_sparse_matrix.h>
 #include <generic_test.hpp>
@@ -52,13 +53,14 @@ int main () {
 
     std::cout << std::endl << "========== sparse matrices ==========" << std::endl;
 
-    SparseMatrix spM(10,10);
+    SparseMatrix::Builder spMb(10,10);
     unsigned n = 0;
     for ( unsigned i=0;i<5;++i) {
         n = (n*1237+1493)%1723;
         const int p = (n*1237+1493)%1723;
-        spM(n%10, p%10) = n;
+        spMb.insert(n%10, p%10, n);
     }
+    SparseMatrix spM(spMb);
     genericTest("sparse",spM);
 
     Matrix U(10,10);
@@ -72,13 +74,20 @@ int main () {
     // Mat & Sparse
     Matrix Mzero = spM*U - Matrix(spM)*U - Matrix(spM)*U + spM*U;
     // Sparse & Sparse
-    SparseMatrix spM2(10,10);
+    SparseMatrix::Builder spM2b(10,10);
     for ( unsigned i=0;i<5;++i) {
         n = (n*1007+1493)%2551;
         const int p = (n*1007+1493)%2551;
-        spM2(n%10, p%10) = n;
+        spM2b.insert(n%10, p%10, n);
     }
+    const SparseMatrix spM2(spM2b);
     Mzero += Matrix(spM*spM2) - Matrix(spM)*Matrix(spM2) - Matrix(spM2)*Matrix(spM) + Matrix(spM2*spM);
+    // Sym & Sparse
+    SymMatrix S(10);
+    for (unsigned i=0;i<10;++i)
+        for (unsigned j=i;j<10;++j)
+            S(i,j) = 1.0/(1.0+i+j);
+    Mzero += spM*S - Matrix(spM)*Matrix(S);
     // Vectt & Sparse
     Vector Vzero = (spM*v) - (Matrix(spM)*v);
     if ( Mzero.frobenius_norm() + Vzero.norm() > eps) {
@@ -88,6 +97,21 @@ int main () {
         exit(1);
     }
 
+    // Builder (unordered and duplicate triplets) & transpose
+
+    SparseMatrix::Builder builder(10,10);
+    for (SparseMatrix::const_iterator it=spM.begin();it!=spM.end();++it) {
+        builder.insert(it->first.second,it->first.first,0.5*it->second);
+        builder.insert(it->first.second,it->first.first,0.5*it->second);
+    }
+    const SparseMatrix spMt(builder);
+    Mzero = Matrix(spMt) - Matrix(spM.transpose()) + Matrix(spM).transpose() - Matrix(spMt.transpose()).transpose();
+    if (spMt.size()!=spM.size() || Mzero.frobenius_norm() > eps) {
+        std::cerr << "Error: Builder or transpose is WRONG" << std::endl;
+        Mzero.info();
+        exit(1);
+    }
+
     std::cout << std::endl << "========== fast sparse matrices ==========" << std::endl;
     std::cout << spM;
     FastSparseMatrix fspM(spM);
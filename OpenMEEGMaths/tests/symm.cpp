@@ -39,10 +39,13 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <cmath>
 #include <iostream>
+#include <filesystem>
 
 #include <OpenMEEGMathsConfig.h>
 #include <symmatrix.h>
+#include <OMBinIO.H>
 #include <matrix.h>
+#include <mixed_precision.h>
 #include <generic_test.hpp>
 
 int main() {
@@ -64,5 +67,124 @@ int main() {
     std::cout << "Matrice R : " << std::endl;
     R.info();
 
+    // Block reads from files (across the diagonal).
+
+    for (const std::string suffix : { "bin", "omb", "mat" }) {
+        const std::string name = "symm_block."+suffix;
+        S.save(name);
+        Matrix B;
+        maths::read_block(name.c_str(),B,1,3,0,3);
+        if ((B-S.submat(1,3,0,3)).frobenius_norm()!=0.0) {
+            std::cerr << "Error: block read is WRONG for " << name << std::endl;
+            return 1;
+        }
+    }
+
+    // Blocked products (the size spans several unpacked panels).
+
+    const unsigned M = 300;
+    SymMatrix P(M);
+    for (unsigned i=0;i<M;++i)
+        for (unsigned j=i;j<M;++j)
+            P(i,j) = sin(1.0+i+2.0*j);
+
+    Matrix D(M,7);
+    for (unsigned i=0;i<M;++i)
+        for (unsigned j=0;j<7;++j)
+            D(i,j) = cos(i*(j+1.0));
+
+    const Matrix Pfull(P);
+    const Matrix& PD  = P*D;
+    const Matrix& DtP = D.transpose()*P;
+    const SymMatrix& PP = P*P;
+    double perr = 0.0;
+    for (unsigned i=0;i<M;++i) {
+        for (unsigned j=0;j<7;++j) {
+            double sum = 0.0;
+            for (unsigned k=0;k<M;++k)
+                sum += Pfull(i,k)*D(k,j);
+            perr = std::max(perr,std::abs(PD(i,j)-sum));
+            perr = std::max(perr,std::abs(DtP(j,i)-sum));
+        }
+        for (unsigned j=i;j<M;++j) {
+            double sum = 0.0;
+            for (unsigned k=0;k<M;++k)
+                sum += Pfull(i,k)*Pfull(k,j);
+            perr = std::max(perr,std::abs(PP(i,j)-sum));
+        }
+    }
+    if (perr>eps) {
+        std::cerr << "Error: symmetric matrix products are WRONG (" << perr << ")." << std::endl;
+        return 1;
+    }
+
+    // Memory mapped load, and copying load with checksum verification.
+
+    P.save("symm_blocked.omb");
+    SymMatrix Pmapped("symm_blocked.omb");
+    maths::OMBinIO::memory_mapping = false;
+    SymMatrix Pread("symm_blocked.omb");
+    maths::OMBinIO::memory_mapping = true;
+    Pmapped(0,0) += 1.0; // Private copy on write, the file is unchanged.
+    Pread(0,0) += 1.0;
+    const SymMatrix Preread("symm_blocked.omb");
+    if ((Matrix(Pmapped)-Matrix(Pread)).frobenius_norm()!=0.0 || Preread(0,0)!=P(0,0)) {
+        std::cerr << "Error: omb symmetric matrix IO is WRONG." << std::endl;
+        return 1;
+    }
+
+    // Saving over a mapped file replaces it (the mapping is unchanged), while other files are overwritten
+    // in place (hard links are preserved).
+
+    const SymMatrix& Q = P*2.0;
+    Q.save("symm_blocked.omb");
+    P.save("symm_saved.omb");
+    std::filesystem::remove("symm_link.omb");
+    std::filesystem::create_hard_link("symm_saved.omb","symm_link.omb");
+    Q.save("symm_saved.omb");
+    const SymMatrix Qlink("symm_link.omb");
+    if (Pmapped(M-1,M-1)!=P(M-1,M-1) || Qlink(M-1,M-1)!=Q(M-1,M-1)) {
+        std::cerr << "Error: omb symmetric matrix save is WRONG." << std::endl;
+        return 1;
+    }
+
+    // Mixed precision solve (single precision factorization with refinement).
+
+    const unsigned N = 50;
+    SymMatrix A(N);
+    for (unsigned i=0;i<N;++i)
+        for (unsigned j=i;j<N;++j)
+            A(i,j) = (i==j) ? N : 1.0/(1.0+i+j);
+
+    Matrix B(N,3);
+    for (unsigned i=0;i<N;++i)
+        for (unsigned j=0;j<3;++j)
+            B(i,j) = cos(1.0+i*(j+1));
+
+    Matrix X(B,DEEP_COPY);
+    const MixedPrecisionSolver solver(A);
+    if (!solver.solve(X)) {
+        std::cerr << "Mixed precision solver did not converge." << std::endl;
+        return 1;
+    }
+
+    const double err = (A*X-B).frobenius_norm()/B.frobenius_norm();
+    std::cout << "Mixed precision solve: " << solver.iterations() << " iterations, residual " << err << std::endl;
+    if (err>eps) {
+        std::cerr << "Error: mixed precision solve is not accurate enough." << std::endl;
+        return 1;
+    }
+
+    // A singular matrix must be reported (and the right hand sides left unchanged) instead of aborting.
+
+    SymMatrix Z(N);
+    Z.set(0.0);
+    Matrix Y(B,DEEP_COPY);
+    const MixedPrecisionSolver singular(Z);
+    if (singular.status()==0 || singular.solve(Y) || (Y-B).frobenius_norm()!=0.0) {
+        std::cerr << "Error: mixed precision solve of a singular matrix is not reported." << std::endl;
+        return 1;
+    }
+
     return 0;
 }
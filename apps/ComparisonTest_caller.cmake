@@ -28,6 +28,41 @@ foreach (HEADNUM 1 2 ${HEAD3})
     OPENMEEG_COMPARISON_TEST(H2ECOGM-OLD-Head${HEADNUM} Head${HEADNUM}-old.ecog initialTest/${BASE_FILE_NAME} "-sparse")
 endforeach()
 
+# Verify that the mixed precision adjoint gain matches the double precision one.
+
+OPENMEEG_COMPARISON_TEST(DipGainEEGadjoint-mixed-Head1 Head1-adjoint-mixed.dgem ${OpenMEEG_BINARY_DIR}/tests/Head1-adjoint.dgem
+                         -full DEPENDS DipGainEEGadjoint-Head1)
+
+# Verify that a resumable HeadMat assembly gives the same matrix.
+
+OPENMEEG_COMPARISON_TEST(HM-Head1-resume Head1-resume.hm ${OpenMEEG_BINARY_DIR}/tests/Head1.hm
+                         -sym DEPENDS HM-Head1-resume HM-Head1)
+
+# Verify that the far field approximation of the MEG sensor matrix is close to the exact one.
+
+OPENMEEG_COMPARISON_TEST(H2MM-Head1-farfield Head1-farfield.h2mm ${OpenMEEG_BINARY_DIR}/tests/Head1.h2mm
+                         -full -eps 0.01 DEPENDS H2MM-Head1-farfield H2MM-Head1)
+
+# Verify that the in-memory lead field pipeline matches the gains computed from the intermediate files.
+
+OPENMEEG_COMPARISON_TEST(DipLeadFieldEEG-Head1 Head1-leadfield.dgem ${OpenMEEG_BINARY_DIR}/tests/Head1.dgem
+                         -full DEPENDS DipLeadField-Head1 DipGainEEG-Head1)
+OPENMEEG_COMPARISON_TEST(DipLeadFieldMEG-Head1 Head1-leadfield.dgmm ${OpenMEEG_BINARY_DIR}/tests/Head1.dgmm
+                         -full DEPENDS DipLeadField-Head1 DipGainMEG-Head1)
+
+# Verify that the gains updated from the source solutions match the gains computed from the inverse head matrix.
+
+OPENMEEG_COMPARISON_TEST(DipGainEEGupdate-Head1 Head1-update.dgem ${OpenMEEG_BINARY_DIR}/tests/Head1.dgem
+                         -full DEPENDS DipGainEEGupdate-Head1 DipGainEEG-Head1)
+OPENMEEG_COMPARISON_TEST(DipGainMEGupdate-Head1 Head1-update.dgmm ${OpenMEEG_BINARY_DIR}/tests/Head1.dgmm
+                         -full DEPENDS DipGainMEGupdate-Head1 DipGainMEG-Head1)
+OPENMEEG_COMPARISON_TEST(DipGainMEGupdate-Head1-tangential Head1-update-tangential.dgmm ${OpenMEEG_BINARY_DIR}/tests/Head1-tangential.dgmm
+                         -full DEPENDS DipGainMEGupdate-Head1-tangential DipGainMEG-Head1-tangential)
+OPENMEEG_COMPARISON_TEST(H2MMupdate-Head1-tangential Head1-update-tangential.h2mm ${OpenMEEG_BINARY_DIR}/tests/Head1-tangential.h2mm
+                         -full DEPENDS DipGainMEGupdate-Head1-tangential H2MM-Head1-tangential)
+OPENMEEG_COMPARISON_TEST(DipGainMEGupdate-Head1-moved Head1-update-moved.dgmm ${OpenMEEG_BINARY_DIR}/tests/Head1-update-moved-full.dgmm
+                         -full -eps 1e-12 DEPENDS DipGainMEGupdate-Head1-moved DipGainMEGupdate-Head1-moved-full)
+
 #   TEST EEG RESULTS ON DIPOLES
 
 # defining variables for those who do not use VTK
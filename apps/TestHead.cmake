@@ -11,11 +11,19 @@ set(ASSEMBLE  om_assemble)
 set(INVERSER  om_minverser)
 set(GAIN      om_gain)
 set(FORWARD   om_forward)
+set(LEADFIELD om_leadfield)
 
 OPENMEEG_TEST(assemble-help ${ASSEMBLE} -h)
 OPENMEEG_TEST(inverser-help ${INVERSER} -h)
 OPENMEEG_TEST(gain-help ${GAIN} -h)
 OPENMEEG_TEST(forward-help ${FORWARD} -h)
+OPENMEEG_TEST(leadfield-help ${LEADFIELD} -h)
+
+#   Invalid far field angles are rejected.
+
+OPENMEEG_TEST(assemble-far-field-invalid ${ASSEMBLE} -H2MM Head1.geom Head1.cond Head1.squids Head1.h2mm --far-field x)
+OPENMEEG_TEST(assemble-far-field-negative ${ASSEMBLE} -H2MM Head1.geom Head1.cond Head1.squids Head1.h2mm --far-field -0.1)
+set_tests_properties(assemble-far-field-invalid assemble-far-field-negative PROPERTIES WILL_FAIL TRUE)
 
 function(TESTHEAD HEADNUM)
     set(SUBJECT "Head${HEADNUM}")
@@ -35,6 +43,7 @@ function(TESTHEAD HEADNUM)
     set(SQUIDS                 ${MODELBASE}.squids)
     set(ECOG-ELECTRODES        ${MODELBASE}-ecog.electrodes)
     set(SQUIDS-TANGENTIAL      ${MODELBASE}-tangential.squids)
+    set(SQUIDS-MOVED           ${MODELBASE}-moved.squids)
     set(SQUIDS-NORADIAL        ${MODELBASE}-noradial.squids)
     set(SURFSOURCES            ${MODELBASE}.src)
     set(DIPSOURCES             ${MODELBASE}.srcdip)
@@ -44,6 +53,7 @@ function(TESTHEAD HEADNUM)
     set(AREAS                  ${GENERATEDBASE}.ai)
     set(HMMAT                  ${GENERATEDBASE}.hm)
     set(HMINVMAT               ${GENERATEDBASE}.hm_inv)
+    set(HMRESUMEMAT            ${GENERATEDBASE}-resume.hm)
     set(SSMMAT                 ${GENERATEDBASE}.ssm)
     set(CMMAT                  ${GENERATEDBASE}.cm)
     set(ECOGMMAT               ${GENERATEDBASE}.ecog)
@@ -56,6 +66,7 @@ function(TESTHEAD HEADNUM)
     set(H2MMMAT                ${GENERATEDBASE}.h2mm)
     set(H2MMMAT-TANGENTIAL     ${GENERATEDBASE}-tangential.h2mm)
     set(H2MMMAT-NORADIAL       ${GENERATEDBASE}-noradial.h2mm)
+    set(H2MMMAT-FARFIELD       ${GENERATEDBASE}-farfield.h2mm)
     set(SS2MMMAT               ${GENERATEDBASE}.ss2mm)
     set(SGMMMAT                ${GENERATEDBASE}.sgmm)
     set(DS2IPMAT               ${GENERATEDBASE}.ds2ip)
@@ -70,9 +81,19 @@ function(TESTHEAD HEADNUM)
     set(DGEM-SKULLSCALPMAT     ${GENERATEDBASE}-skullscalp.dgem)
     set(DGEMADJOINTMAT         ${GENERATEDBASE}-adjoint.dgem)
     set(DGEMADJOINT2MAT        ${GENERATEDBASE}-adjoint2.dgem)
+    set(DGEMADJOINTMIXEDMAT    ${GENERATEDBASE}-adjoint-mixed.dgem)
     set(DGMMMAT                ${GENERATEDBASE}.dgmm)
     set(DGMMADJOINTMAT         ${GENERATEDBASE}-adjoint.dgmm)
     set(DGMMADJOINT2MAT        ${GENERATEDBASE}-adjoint2.dgmm)
+    set(DGEMLEADFIELDMAT       ${GENERATEDBASE}-leadfield.dgem)
+    set(DGMMLEADFIELDMAT       ${GENERATEDBASE}-leadfield.dgmm)
+    set(DSOLMAT                ${GENERATEDBASE}.dsol)
+    set(DGEMUPDATEMAT          ${GENERATEDBASE}-update.dgem)
+    set(DGMMUPDATEMAT          ${GENERATEDBASE}-update.dgmm)
+    set(DGMMUPDATEMAT-TANGENTIAL ${GENERATEDBASE}-update-tangential.dgmm)
+    set(H2MMUPDATEMAT-TANGENTIAL ${GENERATEDBASE}-update-tangential.h2mm)
+    set(DGMMUPDATEMAT-MOVED    ${GENERATEDBASE}-update-moved.dgmm)
+    set(DGMMUPDATEMAT-MOVEDFULL ${GENERATEDBASE}-update-moved-full.dgmm)
     set(DGMMMAT-TANGENTIAL     ${GENERATEDBASE}-tangential.dgmm)
     set(DGMMMAT-NORADIAL       ${GENERATEDBASE}-noradial.dgmm)
 
@@ -89,6 +110,15 @@ function(TESTHEAD HEADNUM)
 
     if (${HEADNUM} EQUAL 1)
 
+        # Resume the assembly from a checkpoint whose last block was interrupted.
+
+        OPENMEEG_TEST(HM-${SUBJECT}-interrupted ${OpenMEEG_BINARY_DIR}/tests/test_assembly_checkpoint ${GEOM} ${COND}
+                      ${HMRESUMEMAT}.checkpoint DEPENDS CLEAN-TESTS)
+        OPENMEEG_TEST(HM-${SUBJECT}-resume ${ASSEMBLE} -HM ${GEOM} ${COND} ${HMRESUMEMAT} --resume DEPENDS HM-${SUBJECT}-interrupted)
+        set_tests_properties(HM-${SUBJECT}-resume PROPERTIES PASS_REGULAR_EXPRESSION "Resuming assembly from .*: [1-9][0-9]* block")
+        OPENMEEG_TEST(HMInv-${SUBJECT}-profile ${INVERSER} ${HMRESUMEMAT} ${HMRESUMEMAT}_inv --profile ${GENERATEDBASE}-inverser-profile.json
+                      DEPENDS HM-${SUBJECT}-resume)
+
         OPENMEEG_TEST(SSM-${SUBJECT} ${ASSEMBLE} -SSM ${GEOM} ${COND} ${SRCMESH} ${SSMMAT} DEPENDS CLEAN-TESTS)
 
         # corticalMat tests
@@ -122,6 +152,9 @@ function(TESTHEAD HEADNUM)
 
     if (${HEADNUM} EQUAL 1)
 
+        OPENMEEG_TEST(H2MM-${SUBJECT}-farfield ${ASSEMBLE} -H2MM ${GEOM} ${COND} ${SQUIDS} ${H2MMMAT-FARFIELD} --far-field 0.3
+                      DEPENDS CLEAN-TESTS)
+
         OPENMEEG_TEST(SS2MM-${SUBJECT} ${ASSEMBLE} -SS2MM ${SRCMESH} ${SQUIDS} ${SS2MMMAT} DEPENDS CLEAN-TESTS)
 
         OPENMEEG_TEST(SurfGainMEG-${SUBJECT} ${GAIN} -MEG ${HMINVMAT} ${SSMMAT} ${H2MMMAT} ${SS2MMMAT} ${SGMMMAT}
@@ -178,6 +211,8 @@ function(TESTHEAD HEADNUM)
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2EM-${SUBJECT})
     OPENMEEG_TEST(DipGainEEGadjoint-${SUBJECT} ${GAIN} -EEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2EMMAT} ${DGEMADJOINTMAT}
                   DEPENDS HM-${SUBJECT} H2EM-${SUBJECT})
+    OPENMEEG_TEST(DipGainEEGadjoint-mixed-${SUBJECT} ${GAIN} -EEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2EMMAT} ${DGEMADJOINTMIXEDMAT} -mixed-precision
+                  DEPENDS HM-${SUBJECT} H2EM-${SUBJECT})
     OPENMEEG_TEST(DipGainMEG-${SUBJECT} ${GAIN} -MEG ${HMINVMAT} ${DSMMAT} ${H2MMMAT} ${DS2MMMAT} ${DGMMMAT}
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2MM-${SUBJECT} DS2MM-${SUBJECT})
     OPENMEEG_TEST(DipGainMEGadjoint-${SUBJECT} ${GAIN} -MEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2MMMAT} ${DS2MMMAT} ${DGMMADJOINTMAT}
@@ -188,6 +223,30 @@ function(TESTHEAD HEADNUM)
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2MM-${SUBJECT}-noradial DS2MM-${SUBJECT}-noradial)
     OPENMEEG_TEST(DipGainEEGMEGadjoint-${SUBJECT} ${GAIN} -EEGMEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2EMMAT} ${H2MMMAT} ${DS2MMMAT} ${DGEMADJOINT2MAT} ${DGMMADJOINT2MAT}
                   DEPENDS HM-${SUBJECT} H2EM-${SUBJECT} H2MM-${SUBJECT} DS2MM-${SUBJECT})
+    if (${HEADNUM} EQUAL 1)
+        OPENMEEG_TEST(DipLeadField-${SUBJECT} ${LEADFIELD} ${GEOM} ${COND} ${DIPPOS} -EEG ${PATCHES} ${DGEMLEADFIELDMAT}
+                      -MEG ${SQUIDS} ${DGMMLEADFIELDMAT} DEPENDS CLEAN-TESTS)
+
+        # Gains from the source solutions (after a re-registration of the sensors). All the squids are rotated
+        # between the standard and the tangential squids, while only one squid out of two is rotated in the moved
+        # squids: the update from the standard squids then copies the lines of the other ones.
+
+        OPENMEEG_TEST(DipSourceSolutions-${SUBJECT} ${GAIN} -SourceSolutions ${HMMAT} ${DSMMAT} ${DSOLMAT}
+                      DEPENDS HM-${SUBJECT} DSM-${SUBJECT})
+        OPENMEEG_TEST(DipGainEEGupdate-${SUBJECT} ${GAIN} -EEGupdate ${DSOLMAT} ${GEOM} ${COND} ${PATCHES} ${DGEMUPDATEMAT}
+                      DEPENDS DipSourceSolutions-${SUBJECT})
+        OPENMEEG_TEST(DipGainMEGupdate-${SUBJECT} ${GAIN} -MEGupdate ${DSOLMAT} ${GEOM} ${COND} ${DIPPOS} ${SQUIDS} ${DGMMUPDATEMAT}
+                      DEPENDS DipSourceSolutions-${SUBJECT})
+        OPENMEEG_TEST(DipGainMEGupdate-${SUBJECT}-tangential ${GAIN} -MEGupdate ${DSOLMAT} ${GEOM} ${COND} ${DIPPOS}
+                      ${SQUIDS-TANGENTIAL} ${DGMMUPDATEMAT-TANGENTIAL} ${SQUIDS} ${H2MMMAT} ${H2MMUPDATEMAT-TANGENTIAL}
+                      DEPENDS DipSourceSolutions-${SUBJECT} H2MM-${SUBJECT})
+        OPENMEEG_TEST(DipGainMEGupdate-${SUBJECT}-moved ${GAIN} -MEGupdate ${DSOLMAT} ${GEOM} ${COND} ${DIPPOS}
+                      ${SQUIDS-MOVED} ${DGMMUPDATEMAT-MOVED} ${SQUIDS} ${H2MMMAT}
+                      DEPENDS DipSourceSolutions-${SUBJECT} H2MM-${SUBJECT})
+        set_tests_properties(DipGainMEGupdate-${SUBJECT}-moved PROPERTIES PASS_REGULAR_EXPRESSION "Head2MEGMat: 81 of 162 sensors moved")
+        OPENMEEG_TEST(DipGainMEGupdate-${SUBJECT}-moved-full ${GAIN} -MEGupdate ${DSOLMAT} ${GEOM} ${COND} ${DIPPOS}
+                      ${SQUIDS-MOVED} ${DGMMUPDATEMAT-MOVEDFULL} DEPENDS DipSourceSolutions-${SUBJECT})
+    endif()
     OPENMEEG_TEST(DipGainInternalPot-${SUBJECT} ${GAIN} -IP ${HMINVMAT} ${DSMMAT} ${H2IPMAT} ${DS2IPMAT} ${DGIPMAT}
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2IPM-${SUBJECT} S2IPM-${SUBJECT})
 
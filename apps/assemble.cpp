@@ -37,6 +37,8 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <stdexcept>
@@ -50,6 +52,8 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <assemble.h>
 #include <sensors.h>
 #include <geometry.h>
+#include <matrix_cache.h>
+#include <instrumentation.h>
 
 using namespace OpenMEEG;
 
@@ -63,6 +67,8 @@ int main(int argc, char** argv)
 {
     print_version(argv[0]);
 
+    const std::string& profile = Profiler::option(argc,argv);
+
     bool OLD_ORDERING = false;
     if (argc<2) {
         getHelp(argv);
@@ -75,6 +81,48 @@ int main(int argc, char** argv)
         }
     }
 
+    // The --checkpoint and --resume flags can be given anywhere after the option (they only apply to -HeadMat).
+
+    bool checkpointing = false;
+    bool resume        = false;
+    for (int i=2;i<argc;++i)
+        if (!strcmp(argv[i],"--checkpoint") || !strcmp(argv[i],"--resume")) {
+            checkpointing = true;
+            resume        = resume || !strcmp(argv[i],"--resume");
+            std::copy(argv+i+1,argv+argc,argv+i);
+            --argc;
+            --i;
+        }
+
+    // The --far-field theta option can be given anywhere after the option (it only applies to -Head2MEGMat,
+    // -SurfSource2MEGMat and -Head2InternalPotMat).
+
+    double theta = 0.0;
+    for (int i=2;i<argc;++i)
+        if (!strcmp(argv[i],"--far-field")) {
+            char* end = nullptr;
+            if (i+1<argc)
+                theta = std::strtod(argv[i+1],&end);
+            if (end==nullptr || end==argv[i+1] || *end!='\0' || !(theta>=0.0)) {
+                std::cerr << "Error: --far-field expects a non negative angle (in radians)." << std::endl;
+                exit(1);
+            }
+            std::copy(argv+i+2,argv+argc,argv+i);
+            argc -= 2;
+            break;
+        }
+
+    // The --blocks file option can be given anywhere after the option (it only applies to -HeadMat).
+
+    std::string blocks_file;
+    for (int i=2;i+1<argc;++i)
+        if (!strcmp(argv[i],"--blocks")) {
+            blocks_file = argv[i+1];
+            std::copy(argv+i+2,argv+argc,argv+i);
+            argc -= 2;
+            break;
+        }
+
     if (option(argc,argv,{"-h","--help"}, {})) getHelp(argv);
 
     print_commandline(argc, argv);
@@ -96,9 +144,35 @@ int main(int argc, char** argv)
         if (!geo.selfCheck())
             exit(1);
 
-        // Assembling Matrix from discretization.
-        HeadMat HM(geo,gauss_order);
+        // Assembling Matrix from discretization (unless it is already in the cache).
+        // With --checkpoint or --resume, completed blocks are recorded in a sidecar file, which is removed
+        // once the matrix is saved.
+        const std::string checkpoint = std::string(argv[4])+".checkpoint";
+        MatrixCache cache("HeadMat");
+        cache << geo << gauss_order;
+        // With --blocks, the head matrix is recombined from the conductivity independent blocks stored in this
+        // file (which are computed and saved first if the file does not exist yet).
+        const SymMatrix& HM = cache.fetch<SymMatrix>([&]() -> SymMatrix {
+            if (blocks_file.empty())
+                return (checkpointing) ? HeadMat(geo,gauss_order,checkpoint,resume) : HeadMat(geo,gauss_order);
+            HeadMatBlocks blocks;
+            if (std::ifstream(blocks_file)) {
+                std::cout << "Using head matrix blocks " << blocks_file << "." << std::endl;
+                try {
+                    blocks.load(blocks_file,geo,gauss_order);
+                } catch (const std::invalid_argument& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                    exit(1);
+                }
+            } else {
+                blocks = HeadMatBlocks(geo,gauss_order);
+                blocks.save(blocks_file);
+            }
+            return HeadMat(geo,blocks);
+        });
         HM.save(argv[4]);
+        if (checkpointing)
+            std::remove(checkpoint.c_str());
     } else if (option(argc,argv,{ "-CorticalMat","-CM","-cm" },
                                 { "geometry file","conductivity file","sensors file","domain name","output file" })) {
 
@@ -208,7 +282,9 @@ int main(int argc, char** argv)
             adapt_rhs = false;
         }
 
-        DipSourceMat dsm(geo, dipoles, gauss_order, adapt_rhs, domain_name);
+        MatrixCache cache("DipSourceMat");
+        cache << geo << dipoles << gauss_order << adapt_rhs << domain_name;
+        const Matrix& dsm = cache.fetch<Matrix>([&]() { return DipSourceMat(geo,dipoles,gauss_order,adapt_rhs,domain_name); });
         // Saving RHS Matrix for dipolar case.
         dsm.save(argv[5]);
     }
@@ -245,7 +321,9 @@ int main(int argc, char** argv)
 
         // Assembling Matrix from discretization.
         // Head2EEG is the linear application which maps x |----> v
-        Head2EEGMat mat(geo, electrodes);
+        MatrixCache cache("Head2EEGMat");
+        cache << geo << electrodes;
+        const SparseMatrix& mat = cache.fetch<SparseMatrix>([&]() { return Head2EEGMat(geo,electrodes); });
         // Saving Head2EEG Matrix.
         mat.save(argv[5]);
     }
@@ -301,7 +379,9 @@ int main(int argc, char** argv)
         Sensors sensors(argv[4]);
 
         // Assembling Matrix from discretization.
-        Head2MEGMat mat(geo, sensors);
+        MatrixCache cache("Head2MEGMat");
+        cache << geo << sensors << theta;
+        const Matrix& mat = cache.fetch<Matrix>([&]() { return Head2MEGMat(geo,sensors,theta); });
         // Saving Head2MEG Matrix.
         mat.save(argv[5]); // if outfile is specified
     }
@@ -320,7 +400,7 @@ int main(int argc, char** argv)
         Sensors sensors(argv[3]);
 
         // Assembling Matrix from discretization.
-        SurfSource2MEGMat mat(mesh_sources, sensors);
+        SurfSource2MEGMat mat(mesh_sources,sensors,theta);
         // Saving SurfSource2MEG Matrix.
         mat.save(argv[4]);
     }
@@ -355,10 +435,19 @@ int main(int argc, char** argv)
 
         // Loading surfaces from geometry file
         Geometry geo(argv[2],argv[3],OLD_ORDERING);
-        Matrix points(argv[4]);
-        Surf2VolMat mat(geo, points);
-        // Saving SurfToVol Matrix.
-        mat.save(argv[5]);
+
+        // A VTK rectilinear grid (.vtk) or a file with one point per line.
+
+        if (tolower(getFilenameExtension(argv[4]))=="vtk") {
+            const RectilinearGrid grid(argv[4]);
+            Surf2VolMat mat(geo,grid,theta);
+            mat.save(argv[5]);
+        } else {
+            Matrix points(argv[4]);
+            Surf2VolMat mat(geo,points,theta);
+            // Saving SurfToVol Matrix.
+            mat.save(argv[5]);
+        }
     }
     /*********************************************************************************************
     * Computation of the discrete linear application which maps the dipoles
@@ -390,6 +479,9 @@ int main(int argc, char** argv)
     auto end_time = std::chrono::system_clock::now();
     dispEllapsed(end_time-start_time);
 
+    if (profile!="" && !Profiler::save(profile))
+        std::cerr << "Cannot write the profile report " << profile << std::endl;
+
     return 0;
 }
 
@@ -426,7 +518,13 @@ void getHelp(char** argv) {
               << "             Arguments:" << std::endl
               << "               geometry file (.geom)" << std::endl
               << "               conductivity file (.cond)" << std::endl
-              << "               output matrix" << std::endl << std::endl;
+              << "               output matrix" << std::endl
+              << "             With --checkpoint, completed blocks are saved in the sidecar file \"output matrix\".checkpoint." << std::endl
+              << "             With --resume, an interrupted assembly restarts from this file (and keeps checkpointing)." << std::endl
+              << "             With --blocks file, the matrix is recombined from the conductivity independent blocks" << std::endl
+              << "             saved in file (computed and saved there first if it does not exist). This makes the" << std::endl
+              << "             assembly for other conductivities (with the same non-conductive domains) almost free." << std::endl
+              << "             A blocks file computed for another geometry or integration order is rejected." << std::endl << std::endl;
 
     std::cout << "   -CorticalMat, -CM, -cm:   " << std::endl
               << "       Compute Cortical Matrix for Symmetric BEM (left-hand side of linear system)." << std::endl
@@ -495,7 +593,9 @@ void getHelp(char** argv) {
               << "               geometry file (.geom)" << std::endl
               << "               conductivity file (.cond)" << std::endl
               << "               file containing the positions and orientations of the MEG sensors (.squids)" << std::endl
-              << "               output matrix" << std::endl << std::endl;
+              << "               output matrix" << std::endl
+              << "               (Optional) --far-field theta: approximate the contributions of the mesh parts" << std::endl
+              << "                   seen from the sensors with an angle smaller than theta (e.g. 0.1)" << std::endl << std::endl;
 
     std::cout << "   -SurfSource2MEGMat, -SS2MM, -ss2mm: " << std::endl
               << "        Compute the linear application which maps the " << std::endl
@@ -503,7 +603,8 @@ void getHelp(char** argv) {
               << "            Arguments:" << std::endl
               << "               mesh file for distributed sources (.tri .vtk .mesh .bnd)" << std::endl
               << "               positions and orientations of the MEG sensors (.squids)" << std::endl
-              << "               output matrix" << std::endl << std::endl;
+              << "               output matrix" << std::endl
+              << "               (Optional) --far-field theta: as for -Head2MEGMat" << std::endl << std::endl;
 
     std::cout << "   -DipSource2MEGMat, -DS2MM, -ds2mm:  " << std::endl
               << "        Compute the linear application which maps the current dipoles" << std::endl
@@ -519,8 +620,11 @@ void getHelp(char** argv) {
               << "            Arguments:" << std::endl
               << "               geometry file (.geom)" << std::endl
               << "               conductivity file (.cond)" << std::endl
-              << "               a mesh file or a file with point positions at which to evaluate the potential" << std::endl
-              << "               output matrix" << std::endl << std::endl;
+              << "               a file with point positions at which to evaluate the potential, or a VTK" << std::endl
+              << "                   rectilinear grid (.vtk, see MakeRectiGridPts.sci) whose points are all kept" << std::endl
+              << "               output matrix" << std::endl
+              << "               (Optional) --far-field theta: integrate numerically the triangles seen from" << std::endl
+              << "                   the points with an angle smaller than theta (e.g. 0.2)" << std::endl << std::endl;
 
     std::cout << "   -DipSource2InternalPotMat, -DS2IPM -ds2ipm:   " << std::endl
               << "        Compute the linear transformation  which maps the current dipoles" << std::endl
@@ -533,5 +637,7 @@ void getHelp(char** argv) {
               << "               output matrix" << std::endl
               << "               (Optional) domain name where lie all dipoles." << std::endl << std::endl;
 
+    std::cout << "   --profile report.json : write timers, counters and memory usage in report.json" << std::endl << std::endl;
+
     exit(0);
 }
@@ -40,6 +40,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <om_utils.h>
 #include <commandline.h>
 #include <gain.h>
+#include <instrumentation.h>
 
 using namespace OpenMEEG;
 
@@ -57,6 +58,8 @@ main(int argc,char** argv) {
 
     print_version(argv[0]);
 
+    const std::string& profile = Profiler::option(argc,argv);
+
     if (argc<2)
         error(argv[0]);
 
@@ -67,6 +70,18 @@ main(int argc,char** argv) {
 
     print_commandline(argc,argv);
 
+    // The -mixed-precision flag can be given anywhere after the option and applies to the adjoint methods
+    // and to -SourceSolutions.
+
+    bool mixed_precision = false;
+    for (int i=2;i<argc;++i)
+        if (!strcmp(argv[i],"-mixed-precision")) {
+            mixed_precision = true;
+            std::copy(argv+i+1,argv+argc,argv+i);
+            --argc;
+            break;
+        }
+
     const std::string& option = argv[1];
     if (argc<5)
         error(argv[0]);
@@ -102,7 +117,7 @@ main(int argc,char** argv) {
         const SymMatrix HeadMat(argv[5]);
         const SparseMatrix Head2EEGMat(argv[6]);
 
-        const GainEEGadjoint EEGGainMat(geo, dipoles, HeadMat, Head2EEGMat);
+        const GainEEGadjoint EEGGainMat(geo,dipoles,HeadMat,Head2EEGMat,mixed_precision);
         EEGGainMat.save(argv[7]);
 
     } else if (!strcmp(argv[1],"-MEG")) {
@@ -137,7 +152,7 @@ main(int argc,char** argv) {
         const Matrix Head2MEGMat(argv[6]);
         const Matrix Source2MEGMat(argv[7]);
 
-        const GainMEGadjoint MEGGainMat(geo, dipoles, HeadMat, Head2MEGMat, Source2MEGMat);
+        const GainMEGadjoint MEGGainMat(geo,dipoles,HeadMat,Head2MEGMat,Source2MEGMat,mixed_precision);
         MEGGainMat.save(argv[8]);
 
     } else if (!strcmp(argv[1],"-EEGMEGadjoint")) {
@@ -154,10 +169,56 @@ main(int argc,char** argv) {
         const Matrix Head2MEGMat(argv[7]);
         const Matrix Source2MEGMat(argv[8]);
 
-        const GainEEGMEGadjoint EEGMEGGainMat(geo, dipoles, HeadMat, Head2EEGMat, Head2MEGMat, Source2MEGMat);
+        const GainEEGMEGadjoint EEGMEGGainMat(geo,dipoles,HeadMat,Head2EEGMat,Head2MEGMat,Source2MEGMat,mixed_precision);
         EEGMEGGainMat.saveEEG(argv[9]);
         EEGMEGGainMat.saveMEG(argv[10]);
 
+    } else if (!strcmp(argv[1],"-SourceSolutions")) {
+
+        // Solutions HeadMatInv*SourceMat, reused by -EEGupdate and -MEGupdate when the sensors are re-registered
+
+        const SymMatrix HeadMat(argv[2]);
+        const Matrix SourceMat(argv[3]);
+
+        const SourceSolutions X(HeadMat,SourceMat,mixed_precision);
+        X.save(argv[4]);
+
+    } else if (!strcmp(argv[1],"-EEGupdate")) {
+
+        // EEG gain for re-registered electrodes from the source solutions (Head2EEGMat is cheap and fully recomputed)
+
+        if (argc<7)
+            error(argv[0]);
+
+        Geometry geo(argv[3],argv[4]);
+        const Sensors electrodes(argv[5]);
+        const Head2EEGMat H2EM(geo,electrodes);
+
+        const SourceSolutions X = Matrix(argv[2]);
+        const GainEEG EEGGainMat(X,H2EM);
+        EEGGainMat.save(argv[6]);
+
+    } else if (!strcmp(argv[1],"-MEGupdate")) {
+
+        // MEG gain for re-registered squids from the source solutions. Given the previous squids and Head2MEGMat,
+        // only the lines of the squids which moved are recomputed and the updated Head2MEGMat can be saved.
+
+        if (argc!=8 && argc!=10 && argc!=11)
+            error(argv[0]);
+
+        Geometry geo(argv[3],argv[4]);
+        const Matrix dipoles(argv[5]);
+        const Sensors squids(argv[6]);
+
+        const Head2MEGMat& H2MM = (argc==8) ? Head2MEGMat(geo,squids) :
+                                              Head2MEGMat(geo,squids,Sensors(argv[8]),Matrix(argv[9]));
+        if (argc==11)
+            H2MM.save(argv[10]);
+
+        const SourceSolutions X = Matrix(argv[2]);
+        const GainMEG MEGGainMat(X,H2MM,DipSource2MEGMat(dipoles,squids));
+        MEGGainMat.save(argv[7]);
+
     } else if (!strcmp(argv[1],"-InternalPotential") || !strcmp(argv[1],"-IP")) {
 
         if (argc<7)
@@ -197,6 +258,9 @@ main(int argc,char** argv) {
     const auto end_time = std::chrono::system_clock::now();
     dispEllapsed(end_time-start_time);
 
+    if (profile!="" && !Profiler::save(profile))
+        std::cerr << "Cannot write the profile report " << profile << std::endl;
+
     return 0;
 }
 
@@ -250,5 +314,35 @@ getHelp(char** argv) {
     std::cout << "            HeadMat, Head2EEGMat, Head2MEGMat, Source2MEGMat, EEGGainMatrix, MEGGainMatrix" << std::endl;
     std::cout << "            bin Matrix" << std::endl << std::endl;
 
+    std::cout << "   -SourceSolutions :   Compute the solutions HeadMatInv*SourceMat, which do not depend on the sensors" << std::endl;
+    std::cout << "            Filepaths are in order :" << std::endl;
+    std::cout << "            HeadMat, SourceMat, SourceSolutions" << std::endl;
+    std::cout << "            bin Matrix" << std::endl << std::endl;
+
+    std::cout << "   -EEGupdate :   Compute the gain for EEG from the source solutions (after a re-registration of the electrodes)" << std::endl;
+    std::cout << "            Filepaths are in order :" << std::endl;
+    std::cout << "            SourceSolutions" << std::endl;
+    std::cout << "            geometry file (.geom)" << std::endl;
+    std::cout << "            conductivity file (.cond)" << std::endl;
+    std::cout << "            electrodes positions, EEGGainMatrix" << std::endl;
+    std::cout << "            bin Matrix" << std::endl << std::endl;
+
+    std::cout << "   -MEGupdate :   Compute the gain for MEG from the source solutions (after a re-registration of the squids)" << std::endl;
+    std::cout << "            Filepaths are in order :" << std::endl;
+    std::cout << "            SourceSolutions" << std::endl;
+    std::cout << "            geometry file (.geom)" << std::endl;
+    std::cout << "            conductivity file (.cond)" << std::endl;
+    std::cout << "            dipoles positions and orientations" << std::endl;
+    std::cout << "            squids positions and orientations, MEGGainMatrix" << std::endl;
+    std::cout << "            [previous squids, previous Head2MEGMat [, updated Head2MEGMat]] (optional)" << std::endl;
+    std::cout << "            With the previous squids and Head2MEGMat, only the lines of the squids which moved are computed." << std::endl;
+    std::cout << "            bin Matrix" << std::endl << std::endl;
+
+    std::cout << "   -mixed-precision : (with the adjoint options and -SourceSolutions) factorize HeadMat in single precision" << std::endl;
+    std::cout << "            and refine the solution in double precision (faster, about 25% less memory than the" << std::endl;
+    std::cout << "            double precision solve as HeadMat is kept for the residuals)." << std::endl << std::endl;
+
+    std::cout << "   --profile report.json : write timers, counters and memory usage in report.json" << std::endl << std::endl;
+
     exit(0);
 }
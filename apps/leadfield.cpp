@@ -0,0 +1,140 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <om_utils.h>
+#include <commandline.h>
+#include <forward_pipeline.h>
+
+using namespace OpenMEEG;
+
+void
+getHelp(const char* command) {
+    std::cout << command << " [-h | --help] geometry conductivity dipoles [options]" << std::endl << std::endl
+              << "   Compute dipole lead fields in a single run, without writing the intermediate matrices." << std::endl
+              << "   Filepaths are in order :" << std::endl
+              << "   geometry file (.geom), conductivity file (.cond), dipoles positions and orientations" << std::endl
+              << "   Options (at least one of -EEG or -MEG is required) :" << std::endl
+              << "   -EEG electrodes EEGGainMatrix   : EEG electrodes positions (.patches) and output gain matrix" << std::endl
+              << "   -MEG squids MEGGainMatrix       : MEG sensors positions and orientations (.squids) and output gain matrix" << std::endl
+              << "   -keep directory                 : also save the intermediate matrices in this directory" << std::endl
+              << "   -mixed-precision                : factorize the head matrix in single precision with iterative refinement" << std::endl
+              << "   -old-ordering                   : use the old ordering of the unknowns" << std::endl
+              << std::endl;
+}
+
+void error(const char* command,const bool unknown_option=false) {
+    std::cerr << "Error: " << ((unknown_option) ? "Unknown option." : "Not enough arguments.") << std::endl;
+    getHelp(command);
+    exit(1);
+}
+
+int
+main(int argc,char** argv) {
+
+    print_version(argv[0]);
+
+    if (argc>1 && (!strcmp(argv[1],"-h") || !strcmp(argv[1],"--help"))) {
+        getHelp(argv[0]);
+        return 0;
+    }
+
+    if (argc<6)
+        error(argv[0]);
+
+    print_commandline(argc,argv);
+
+    const char* electrodes_file = nullptr;
+    const char* eeg_gain_file   = nullptr;
+    const char* squids_file     = nullptr;
+    const char* meg_gain_file   = nullptr;
+    bool        old_ordering    = false;
+
+    ForwardPipeline::Options options;
+    for (int i=4; i<argc; ++i) {
+        if (!strcmp(argv[i],"-EEG")) {
+            if (i+2>=argc)
+                error(argv[0]);
+            electrodes_file = argv[++i];
+            eeg_gain_file   = argv[++i];
+        } else if (!strcmp(argv[i],"-MEG")) {
+            if (i+2>=argc)
+                error(argv[0]);
+            squids_file   = argv[++i];
+            meg_gain_file = argv[++i];
+        } else if (!strcmp(argv[i],"-keep")) {
+            if (i+1>=argc)
+                error(argv[0]);
+            options.spill_directory = argv[++i];
+        } else if (!strcmp(argv[i],"-mixed-precision")) {
+            options.mixed_precision = true;
+        } else if (!strcmp(argv[i],"-old-ordering")) {
+            old_ordering = true;
+        } else {
+            error(argv[0],true);
+        }
+    }
+
+    if (electrodes_file==nullptr && squids_file==nullptr)
+        error(argv[0]);
+
+    // Start Chrono
+
+    const auto start_time = std::chrono::system_clock::now();
+
+    const Geometry geo(argv[1],argv[2],old_ordering);
+    const Matrix   dipoles(argv[3]);
+
+    const Sensors electrodes = (electrodes_file!=nullptr) ? Sensors(electrodes_file) : Sensors();
+    const Sensors squids     = (squids_file!=nullptr)     ? Sensors(squids_file)     : Sensors();
+
+    ForwardPipeline pipeline(geo,options);
+    pipeline.compute(dipoles,(electrodes_file!=nullptr) ? &electrodes : nullptr,(squids_file!=nullptr) ? &squids : nullptr);
+
+    if (eeg_gain_file!=nullptr)
+        pipeline.eeg().save(eeg_gain_file);
+    if (meg_gain_file!=nullptr)
+        pipeline.meg().save(meg_gain_file);
+
+    // Stop Chrono
+
+    const auto end_time = std::chrono::system_clock::now();
+    dispEllapsed(end_time-start_time);
+
+    return 0;
+}
@@ -42,6 +42,8 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <matrix.h>
 #include <symmatrix.h>
 #include <vector.h>
+#include <matrix_cache.h>
+#include <instrumentation.h>
 
 #include <commandline.h>
 #include <om_utils.h>
@@ -53,7 +55,8 @@ getHelp(char** argv) {
     std::cout << argv[0] <<" [-option] [filepaths...]" << std::endl << std::endl
               << "   Inverse HeadMatrix " << std::endl
               << "   Filepaths are in order :" << std::endl
-              << "       HeadMat (bin), HeadMatInv (bin)" << std::endl << std::endl;
+              << "       HeadMat (bin), HeadMatInv (bin)" << std::endl
+              << "   --profile report.json : write timers, counters and memory usage in report.json" << std::endl << std::endl;
 
     exit(0);
 }
@@ -70,6 +73,8 @@ main(int argc,char* argv[]) {
 
     if ((!strcmp(argv[1],"-h")) || (!strcmp(argv[1],"--help"))) getHelp(argv);
 
+    const std::string& profile = Profiler::option(argc,argv);
+
     print_commandline(argc,argv);
 
     // Start Chrono
@@ -79,13 +84,25 @@ main(int argc,char* argv[]) {
     SymMatrix HeadMat;
 
     HeadMat.load(argv[1]);
-    HeadMat.invert(); // invert inplace
-    HeadMat.save(argv[2]);
+
+    MatrixCache cache("HeadMatInv");
+    if (cache.enabled())
+        cache << HeadMat;
+
+    const SymMatrix& HeadMatInv = cache.fetch<SymMatrix>([&]() {
+        const ScopedTimer timer("invert");
+        HeadMat.invert(); // invert inplace
+        return HeadMat;
+    });
+    HeadMatInv.save(argv[2]);
 
     // Stop Chrono
 
     auto end_time = std::chrono::system_clock::now();
     dispEllapsed(end_time-start_time);
 
+    if (profile!="" && !Profiler::save(profile))
+        std::cerr << "Cannot write the profile report " << profile << std::endl;
+
     return 0;
 }
@@ -0,0 +1,120 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "commandline.h"
+#include "spherical_head.h"
+
+using namespace OpenMEEG;
+
+//  Parse a comma separated list of values.
+
+template <typename T>
+std::vector<T> values(const std::string& list) {
+    std::vector<T> res;
+    std::istringstream iss(list);
+    std::string item;
+    while (std::getline(iss,item,',')) {
+        std::istringstream is(item);
+        T value;
+        is >> value;
+        res.push_back(value);
+    }
+    return res;
+}
+
+int
+main(int argc,char* argv[]) {
+
+    print_version(argv[0]);
+
+    const CommandLine cmd(argc,argv,"Create a head model made of nested spheres (with dipoles and sensors)");
+    const std::string& basename      = cmd.option("-o",std::string(),"Output basename (basename.geom, basename.cond, ...)");
+    const unsigned     subdivisions  = cmd.option("-s",3u,"Number of icosahedron subdivisions (10*4^s+2 vertices per sphere)");
+    const unsigned     nb_layers     = cmd.option("-l",3u,"Number of layers");
+    const std::string& names         = cmd.option("-names",std::string(),"Comma separated layer names (innermost first)");
+    const std::string& radii         = cmd.option("-radii",std::string(),"Comma separated radii (innermost first)");
+    const std::string& conductivites = cmd.option("-conductivities",std::string(),"Comma separated conductivities (innermost first)");
+    const unsigned     nb_dipoles    = cmd.option("-dipoles",100u,"Number of dipoles");
+    const unsigned     nb_electrodes = cmd.option("-electrodes",64u,"Number of EEG electrodes");
+    const unsigned     nb_squids     = cmd.option("-squids",64u,"Number of MEG sensors");
+
+    if (cmd.help_mode())
+        return 0;
+
+    if (basename=="") {
+        std::cout << "Not enough arguments, try the -h option" << std::endl;
+        return 1;
+    }
+
+    SphericalHead::Layers layers = SphericalHead::default_layers(nb_layers);
+
+    const std::vector<std::string>& layer_names = values<std::string>(names);
+    const std::vector<double>&      layer_radii = values<double>(radii);
+    const std::vector<double>&      layer_conds = values<double>(conductivites);
+    if ((names!="" && layer_names.size()!=nb_layers) || (radii!="" && layer_radii.size()!=nb_layers) ||
+        (conductivites!="" && layer_conds.size()!=nb_layers)) {
+        std::cerr << "The number of names, radii and conductivities must match the number of layers (" << nb_layers << ")." << std::endl;
+        return 1;
+    }
+
+    for (unsigned i=0; i<layer_names.size(); ++i)
+        layers[i].name = layer_names[i];
+    for (unsigned i=0; i<layer_radii.size(); ++i)
+        layers[i].radius = layer_radii[i];
+    for (unsigned i=0; i<layer_conds.size(); ++i)
+        layers[i].conductivity = layer_conds[i];
+
+    try {
+        const SphericalHead head(subdivisions,layers);
+        head.save(basename,nb_dipoles,nb_electrodes,nb_squids);
+
+        std::cout << "Created " << basename << ".geom: " << layers.size() << " spheres of " << head.nb_vertices()
+                  << " vertices and " << head.nb_triangles() << " triangles (" << head.nb_unknowns() << " unknowns)." << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+"""End-to-end scaling benchmark of the OpenMEEG command line tools.
+
+For each refinement level, a nested sphere head is generated with
+om_make_spheres, then the forward problem is solved stage by stage
+(om_assemble, om_minverser, om_gain). Each stage is run with --profile
+and the wall time and peak memory are reported against the number of
+unknowns of the head matrix.
+
+Usage: scaling_benchmark.py [-b bindir] [-l 1,2,3] [-n layers] [-o results.json] [workdir]
+
+The matrix cache is disabled (OPENMEEG_CACHE_DIR is unset) so that every
+stage is really computed. Since the heads are spherical, the EEG and MEG
+leadfields can be checked against the analytic solutions (see
+apps/tools/matlab/om_spher_pot_iso.m and om_spher_mag_iso.m).
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def stages(base):
+    """The forward computation stages, as (name, command) pairs."""
+    geom, cond = base + '.geom', base + '.cond'
+    return [
+        ('HeadMat',          ['om_assemble', '-HM', geom, cond, base + '.hm']),
+        ('HeadMatInv',       ['om_minverser', base + '.hm', base + '.hm_inv']),
+        ('DipSourceMat',     ['om_assemble', '-DSM', geom, cond, base + '.dip', base + '.dsm']),
+        ('Head2EEGMat',      ['om_assemble', '-H2EM', geom, cond, base + '.patches', base + '.h2em']),
+        ('Head2MEGMat',      ['om_assemble', '-H2MM', geom, cond, base + '.squids', base + '.h2mm']),
+        ('DipSource2MEGMat', ['om_assemble', '-DS2MM', base + '.dip', base + '.squids', base + '.ds2mm']),
+        ('GainEEG',          ['om_gain', '-EEG', base + '.hm_inv', base + '.dsm', base + '.h2em', base + '.eeg']),
+        ('GainMEG',          ['om_gain', '-MEG', base + '.hm_inv', base + '.dsm', base + '.h2mm', base + '.ds2mm',
+                              base + '.meg']),
+    ]
+
+
+def run(bindir, command, profile=None):
+    program = os.path.join(bindir, command[0]) if bindir else command[0]
+    args = [program] + command[1:]
+    if profile is not None:
+        args += ['--profile', profile]
+    result = subprocess.run(args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout)
+        raise RuntimeError('Command failed: ' + ' '.join(args))
+    return result.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-b', '--bindir', default='', help='directory of the om_* executables (default: PATH)')
+    parser.add_argument('-l', '--levels', default='1,2,3', help='comma separated sphere subdivision levels')
+    parser.add_argument('-n', '--layers', type=int, default=3, help='number of nested spheres')
+    parser.add_argument('-d', '--dipoles', type=int, default=100, help='number of dipoles')
+    parser.add_argument('-s', '--sensors', type=int, default=64, help='number of EEG and of MEG sensors')
+    parser.add_argument('-o', '--output', help='JSON output file (default: standard output)')
+    parser.add_argument('workdir', nargs='?', help='directory for the generated files (default: temporary)')
+    args = parser.parse_args()
+
+    os.environ.pop('OPENMEEG_CACHE_DIR', None)
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix='om_scaling-')
+    os.makedirs(workdir, exist_ok=True)
+
+    results = []
+    for level in [int(l) for l in args.levels.split(',')]:
+        base = os.path.join(workdir, 'Spheres%d' % level)
+        log = run(args.bindir, ['om_make_spheres', '-o', base, '-s', str(level), '-l', str(args.layers),
+                                '-dipoles', str(args.dipoles), '-electrodes', str(args.sensors),
+                                '-squids', str(args.sensors)])
+        unknowns = int(re.search(r'\((\d+) unknowns\)', log).group(1))
+
+        for name, command in stages(base):
+            profile = '%s.%s.json' % (base, name)
+            run(args.bindir, command, profile)
+            with open(profile) as f:
+                report = json.load(f)
+            results.append({'level': level, 'unknowns': unknowns, 'stage': name,
+                            'wall_time': report['wall_time'], 'peak_rss_kb': report['peak_rss_kb']})
+            sys.stderr.write('%-18s level %d %8d unknowns %10.3f s %10d kB\n' %
+                             (name, level, unknowns, report['wall_time'], report['peak_rss_kb']))
+
+    output = json.dumps({'layers': args.layers, 'dipoles': args.dipoles, 'sensors': args.sensors,
+                         'results': results}, indent=4)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(output + '\n')
+    else:
+        print(output)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,374 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+//  Microbenchmarks of the BEM kernels, of the integrators, of the geometric queries and of the linear algebra
+//  (and matrix I/O) on synthetic nested spheres of increasing refinement. Results are written in JSON, one
+//  entry per benchmark and problem size, so that runs (with different BLAS backends) can be compared.
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <commandline.h>
+#include <analytics.h>
+#include <integrator.h>
+#include <danielsson.h>
+#include <geometry.h>
+#include <matrix.h>
+#include <spherical_head.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+
+using namespace OpenMEEG;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    //  Results are accumulated in this variable so that the compiler cannot drop the benchmarked code.
+
+    volatile double sink = 0.0;
+
+    struct Result {
+        std::string name;
+        size_t      size;       // Problem size (number of vertices, matrix dimension, ...).
+        size_t      operations; // Number of elementary operations per iteration.
+        unsigned    iterations;
+        double      mean;       // Seconds per iteration.
+        double      min;
+    };
+
+    class Benchmarks {
+    public:
+
+        Benchmarks(const double t,const std::string& f): min_time(t),filter(f) { }
+
+        //  Run f (after a warm-up call) until min_time is elapsed.
+
+        void run(const std::string& name,const size_t size,const size_t operations,const std::function<double()>& f) {
+            if (filter!="" && name.find(filter)==std::string::npos)
+                return;
+
+            sink = sink+f();
+
+            Result result = { name, size, operations, 0, 0.0, 1e100 };
+            double total = 0.0;
+            while (total<min_time || result.iterations<3) {
+                const Clock::time_point start = Clock::now();
+                sink = sink+f();
+                const double elapsed = std::chrono::duration<double>(Clock::now()-start).count();
+                total += elapsed;
+                result.min = std::min(result.min,elapsed);
+                ++result.iterations;
+            }
+            result.mean = total/result.iterations;
+            std::cerr << std::left << std::setw(40) << name << std::right << std::setw(8) << size
+                      << std::setw(14) << result.mean*1e9/operations << " ns/op" << std::endl;
+            results.push_back(result);
+        }
+
+        void report(std::ostream& os) const {
+            os << std::setprecision(9) << "{" << std::endl
+               << "    \"version\": \"" << version << "\"," << std::endl
+               << "    \"blas\": \"" << blas() << "\"," << std::endl
+               << "    \"benchmarks\": [";
+            const char* separator = "";
+            for (const auto& result : results) {
+                os << separator << std::endl
+                   << "        { \"name\": \"" << result.name << "\", \"size\": " << result.size
+                   << ", \"operations\": " << result.operations << ", \"iterations\": " << result.iterations
+                   << ", \"mean_seconds\": " << result.mean << ", \"min_seconds\": " << result.min
+                   << ", \"ns_per_operation\": " << result.mean*1e9/result.operations << " }";
+                separator = ",";
+            }
+            os << std::endl << "    ]" << std::endl << "}" << std::endl;
+        }
+
+    private:
+
+        static const char* blas() {
+            #if defined(USE_MKL)
+            return "MKL";
+            #elif defined(USE_OPENBLAS)
+            return "OpenBLAS";
+            #elif defined(USE_ATLAS)
+            return "Atlas";
+            #elif defined(USE_VECLIB)
+            return "vecLib";
+            #elif defined(USE_LAPACK)
+            return "LAPACK";
+            #else
+            return "unknown";
+            #endif
+        }
+
+        const double        min_time;
+        const std::string   filter;
+        std::vector<Result> results;
+    };
+
+    //  Three nested spheres (brain, skull, scalp) with the usual conductivities.
+
+    std::string write_head(const std::filesystem::path& dir,const unsigned level) {
+        const std::string base = (dir/("sphere"+std::to_string(level))).string();
+        const SphericalHead head(level,SphericalHead::default_layers(3));
+        head.save(base,0,0,0);
+        return base;
+    }
+
+    void mesh_benchmarks(Benchmarks& bench,const Geometry& geo) {
+        const Interface& scalp = geo.outermost_interface();
+        const Mesh&      mesh  = scalp.oriented_meshes().front().mesh();
+        const size_t     nv    = mesh.vertices().size();
+        const size_t     nt    = mesh.triangles().size();
+
+        //  Evaluation points slightly off the surface (inside and outside).
+
+        std::vector<Vect3> points;
+        for (const auto& vertex : mesh.vertices()) {
+            points.push_back(0.95*(*vertex));
+            points.push_back(1.05*(*vertex));
+        }
+
+        const Triangle& triangle = mesh.triangles().front();
+
+        bench.run("analyticS::f",nv,points.size(),[&]() {
+            const analyticS analyS(triangle);
+            double sum = 0.0;
+            for (const auto& p : points)
+                sum += analyS.f(p);
+            return sum;
+        });
+
+        bench.run("analyticD3::f",nv,points.size(),[&]() {
+            const analyticD3 analyD(triangle);
+            double sum = 0.0;
+            for (const auto& p : points)
+                sum += analyD.f(p).norm();
+            return sum;
+        });
+
+        const Vect3 r0(0.1,0.2,0.3);
+        const Vect3 q(0.0,0.0,1.0);
+
+        bench.run("analyticDipPotDer::f",nv,points.size(),[&]() {
+            analyticDipPotDer anaDPD;
+            anaDPD.init(triangle,q,r0);
+            double sum = 0.0;
+            for (const auto& p : points)
+                sum += anaDPD.f(p).norm();
+            return sum;
+        });
+
+        bench.run("Integrator<analyticDipPotDer>",nv,nt,[&]() {
+            analyticDipPotDer anaDPD;
+            Integrator<Vect3,analyticDipPotDer> gauss(3u);
+            double sum = 0.0;
+            for (const auto& tr : mesh.triangles()) {
+                anaDPD.init(tr,q,r0);
+                sum += gauss.integrate(anaDPD,tr).norm();
+            }
+            return sum;
+        });
+
+        bench.run("AdaptiveIntegrator<analyticDipPotDer>",nv,nt,[&]() {
+            analyticDipPotDer anaDPD;
+            AdaptiveIntegrator<Vect3,analyticDipPotDer> gauss(0.001);
+            gauss.setOrder(3);
+            double sum = 0.0;
+            for (const auto& tr : mesh.triangles()) {
+                anaDPD.init(tr,q,r0);
+                sum += gauss.integrate(anaDPD,tr).norm();
+            }
+            return sum;
+        });
+
+        //  Points close to each triangle (projecting inside it) and farther (projecting on an edge or a vertex).
+
+        std::vector<std::pair<Vect3,const Triangle*>> triangle_points;
+        for (const auto& tr : mesh.triangles()) {
+            const Vect3 center = (tr.vertex(0)+tr.vertex(1)+tr.vertex(2))/3.0;
+            triangle_points.push_back({ 1.05*center, &tr });
+            triangle_points.push_back({ 1.05*center+(tr.vertex(0)-center)*2.0, &tr });
+        }
+
+        bench.run("dist_point_triangle",nv,triangle_points.size(),[&]() {
+            double sum = 0.0;
+            Vect3  alpha;
+            bool   inside;
+            for (const auto& tp : triangle_points)
+                sum += dist_point_triangle(tp.first,*tp.second,alpha,inside);
+            return sum;
+        });
+
+        bench.run("dist_point_interface",nv,points.size(),[&]() {
+            double sum = 0.0;
+            Vect3    alpha;
+            Triangle nearest;
+            for (const auto& p : points)
+                sum += dist_point_interface(p,scalp,alpha,nearest);
+            return sum;
+        });
+
+        //  Interface::contains is used to locate sources, hence the points are all inside the head.
+
+        std::vector<Vect3> sources;
+        for (const auto& vertex : mesh.vertices()) {
+            sources.push_back(0.5*(*vertex));
+            sources.push_back(0.95*(*vertex));
+        }
+
+        bench.run("Interface::contains",nv,sources.size(),[&]() {
+            double sum = 0.0;
+            for (const auto& p : sources)
+                sum += scalp.contains(p);
+            return sum;
+        });
+    }
+
+    //  Well conditioned symmetric matrix with a deterministic content.
+
+    SymMatrix symmetric_matrix(const size_t n) {
+        SymMatrix S(n);
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<=i; ++j)
+                S(i,j) = (i==j) ? n : std::cos(1.0+i+2.0*j)/(1.0+i-j);
+        return S;
+    }
+
+    Matrix full_matrix(const size_t m,const size_t n) {
+        Matrix M(m,n);
+        for (size_t i=0; i<m; ++i)
+            for (size_t j=0; j<n; ++j)
+                M(i,j) = std::cos(1.0+i+3.0*j);
+        return M;
+    }
+
+    void linear_algebra_benchmarks(Benchmarks& bench,const size_t n,const std::filesystem::path& dir) {
+        const SymMatrix& S = symmetric_matrix(n);
+        const Matrix&    B = full_matrix(n,16);
+
+        bench.run("SymMatrix::solveLin",n,1,[&]() {
+            Matrix X(B,DEEP_COPY);
+            S.solveLin(X);
+            return X(0,0);
+        });
+
+        bench.run("SymMatrix::invert",n,1,[&]() {
+            SymMatrix Sinv(S,DEEP_COPY);
+            Sinv.invert();
+            return Sinv(0,0);
+        });
+
+        //  Banded sparse matrix with 9 entries per line.
+
+        SparseMatrix::Builder banded(n,n);
+        banded.reserve(9*n);
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=((i<4) ? 0 : i-4); j<std::min(n,i+5); ++j)
+                banded.insert(i,j,1.0/(1.0+i+j));
+        const SparseMatrix sparse(banded);
+        Vector x(n);
+        for (size_t i=0; i<n; ++i)
+            x(i) = std::sin(1.0+i);
+
+        bench.run("SparseMatrix*Vector",n,sparse.size(),[&]() {
+            const Vector& y = sparse*x;
+            return y(0);
+        });
+
+        bench.run("SparseMatrix*Matrix",n,sparse.size()*B.ncol(),[&]() {
+            const Matrix& Y = sparse*B;
+            return Y(0,0);
+        });
+
+        const Matrix& M = full_matrix(n,n);
+        for (const std::string& format : { "bin", "omb", "txt" }) {
+            const std::string filename = (dir/("matrix."+format)).string();
+            bench.run("Matrix::save("+format+")",n,M.size(),[&]() { M.save(filename); return 0.0; });
+            bench.run("Matrix::load("+format+")",n,M.size(),[&]() { Matrix L; L.load(filename); return L(0,0); });
+        }
+    }
+}
+
+int
+main(int argc,char** argv) {
+
+    const CommandLine cmd(argc,argv,"Microbenchmarks of OpenMEEG kernels\nom_bench [options]");
+
+    const unsigned    levels   = cmd.option("-levels",3u,"Number of sphere refinement levels (the number of triangles is multiplied by 4 and the matrix sizes double at each level)");
+    const double      min_time = cmd.option("-time",0.2,"Minimum time (in seconds) spent in each benchmark");
+    const std::string filter   = cmd.option("-filter",std::string(""),"Only run the benchmarks whose name contains this string");
+    const std::string output   = cmd.option("-o",std::string(""),"Output JSON file (default: standard output)");
+
+    if (cmd.help_mode())
+        return 0;
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path()/("om_bench-"+std::to_string(Clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(dir);
+
+    Benchmarks bench(min_time,filter);
+    for (unsigned level=1; level<=levels; ++level) {
+        const std::string& base = write_head(dir,level);
+        const Geometry geo(base+".geom",base+".cond");
+        mesh_benchmarks(bench,geo);
+        linear_algebra_benchmarks(bench,125<<level,dir);
+    }
+
+    std::filesystem::remove_all(dir);
+
+    if (output=="") {
+        bench.report(std::cout);
+    } else {
+        std::ofstream ofs(output);
+        bench.report(ofs);
+        if (!ofs) {
+            std::cerr << "Cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
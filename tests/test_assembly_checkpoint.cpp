@@ -0,0 +1,104 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <filesystem>
+#include <iostream>
+
+#include <geometry.h>
+#include <assemble.h>
+#include <matrix_cache.h>
+#include <assembly_checkpoint.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+//  Checks that a head matrix assembly resumed from an interrupted checkpoint (whose last record is truncated)
+//  only recomputes the missing blocks and gives the same matrix as a direct assembly.
+//  If a third argument is given, the truncated checkpoint is also copied there (to test om_assemble --resume).
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=3 && argc!=4) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+    const unsigned gauss_order = 3;
+    const size_t   size        = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+
+    const std::string filename = "test_assembly_checkpoint-"+std::filesystem::path(argv[1]).stem().string()+".checkpoint";
+    std::filesystem::remove(filename);
+
+    MatrixCache id("HeadMat");
+    id << geo << gauss_order;
+
+    auto completed = [&]() {
+        const AssemblyCheckpoint checkpoint(filename,id.hash(),size,true);
+        return checkpoint.nb_completed();
+    };
+
+    const HeadMat reference(geo,gauss_order);
+    bool ok = compare(HeadMat(geo,gauss_order,filename,false),reference,1e-12);
+    const size_t nblocks = completed();
+
+    //  Simulate an interruption while the last block was written.
+
+    std::filesystem::resize_file(filename,std::filesystem::file_size(filename)-1);
+    const size_t nrestored = completed();
+    if (nblocks<2 || nrestored!=nblocks-1) {
+        std::cerr << "Wrong number of blocks in the truncated checkpoint: " << nrestored << " of " << nblocks << std::endl;
+        ok = false;
+    }
+
+    if (argc==4)
+        std::filesystem::copy_file(filename,argv[3],std::filesystem::copy_options::overwrite_existing);
+
+    ok = compare(HeadMat(geo,gauss_order,filename,true),reference,1e-12) && ok;
+    if (completed()!=nblocks) {
+        std::cerr << "The missing block was not recorded by the resumed assembly" << std::endl;
+        ok = false;
+    }
+
+    std::filesystem::remove(filename);
+
+    return (ok) ? 0 : 1;
+}
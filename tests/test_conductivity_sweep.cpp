@@ -0,0 +1,115 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <chrono>
+
+#include <geometry.h>
+#include <assemble.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=4) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+    const std::string domain_name = argv[3];
+
+    const HeadMatBlocks blocks(geo);
+
+    Matrix B(blocks.size(),3);
+    for (unsigned i=0;i<B.nlin();++i)
+        for (unsigned j=0;j<B.ncol();++j)
+            B(i,j) = cos(1.+i*(j+1));
+
+    const ConductivitySweep sweep(geo,blocks,domain_name,B);
+
+    //  Compare with the solutions of the recombined head matrices.
+
+    Domain& domain = *std::find_if(geo.domains().begin(),geo.domains().end(),
+                                   [&](const Domain& d) { return d.name()==domain_name; });
+    const double sigma0 = domain.conductivity();
+
+    bool ok = true;
+    for (const double ratio : { 1.0, 0.1, 0.2, 3.0, 10.0 }) {
+        domain.set_conductivity(ratio*sigma0);
+        Matrix X(B,DEEP_COPY);
+        HeadMat(geo,blocks).solveLin(X);
+        ok = compare(sweep.solve(ratio*sigma0),X,1e-8) && ok;
+    }
+
+    //  The conductivities of a sweep only cost a solve with the reduced pencil, without any factorization: a sweep
+    //  of 50 conductivities must cost less than 25 assemblies and solves of the head matrix (the best of 3 runs are
+    //  compared to limit the influence of the load of the machine).
+
+    typedef std::chrono::steady_clock Clock;
+    const unsigned npoints = 50;
+
+    Clock::duration sweep_time = Clock::duration::max();
+    Clock::duration solve_time = Clock::duration::max();
+    for (unsigned k=0; k<3; ++k) {
+        Clock::time_point start = Clock::now();
+        for (unsigned i=0; i<npoints; ++i)
+            sweep.solve(sigma0*std::pow(10.0,-1.0+2.0*i/(npoints-1)));
+        sweep_time = std::min(sweep_time,Clock::now()-start);
+
+        start = Clock::now();
+        domain.set_conductivity(sigma0*(1.0+k));
+        Matrix X(B,DEEP_COPY);
+        HeadMat(geo,blocks).solveLin(X);
+        solve_time = std::min(solve_time,Clock::now()-start);
+    }
+
+    const double ratio = std::chrono::duration<double>(sweep_time).count()/std::chrono::duration<double>(solve_time).count();
+    std::cout << "Sweep of " << npoints << " conductivities: " << ratio << " times the cost of one head matrix solve." << std::endl;
+    if (ratio>npoints/2) {
+        std::cerr << "Error: the conductivity sweep is too slow." << std::endl;
+        ok = false;
+    }
+
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <geometry.h>
+
+using namespace OpenMEEG;
+namespace fs = std::filesystem;
+
+//  Checks that geometries restored from the cache are identical to the ones read from the files, that an
+//  unchanged geometry is read from the cache, and that modifying one of its meshes invalidates the cache.
+
+bool same(const Geometry& geo1,const Geometry& geo2) {
+    if (geo1.vertices().size()!=geo2.vertices().size() || geo1.meshes().size()!=geo2.meshes().size() ||
+        geo1.domains().size()!=geo2.domains().size() || geo1.nb_parameters()!=geo2.nb_parameters() ||
+        geo1.is_nested()!=geo2.is_nested())
+        return false;
+
+    for (size_t i=0;i<geo1.vertices().size();++i)
+        if (!(geo1.vertices()[i]==geo2.vertices()[i]) || geo1.vertices()[i].index()!=geo2.vertices()[i].index())
+            return false;
+
+    const Vertex* vertex1 = geo1.vertices().data();
+    const Vertex* vertex2 = geo2.vertices().data();
+    for (size_t m=0;m<geo1.meshes().size();++m) {
+        const Mesh& mesh1 = geo1.meshes()[m];
+        const Mesh& mesh2 = geo2.meshes()[m];
+        if (mesh1.name()!=mesh2.name() || mesh1.outermost()!=mesh2.outermost() ||
+            mesh1.current_barrier()!=mesh2.current_barrier() || mesh1.triangles().size()!=mesh2.triangles().size())
+            return false;
+        for (size_t t=0;t<mesh1.triangles().size();++t) {
+            const Triangle& t1 = mesh1.triangles()[t];
+            const Triangle& t2 = mesh2.triangles()[t];
+            if (t1.index()!=t2.index())
+                return false;
+            for (unsigned i=0;i<3;++i)
+                if (&t1.vertex(i)-vertex1!=&t2.vertex(i)-vertex2)
+                    return false;
+        }
+    }
+
+    for (size_t d=0;d<geo1.domains().size();++d) {
+        const Domain& domain1 = geo1.domains()[d];
+        const Domain& domain2 = geo2.domains()[d];
+        if (domain1.name()!=domain2.name() || domain1.conductivity()!=domain2.conductivity() ||
+            domain1.boundaries().size()!=domain2.boundaries().size())
+            return false;
+        for (size_t b=0;b<domain1.boundaries().size();++b) {
+            const auto& omeshes1 = domain1.boundaries()[b].interface().oriented_meshes();
+            const auto& omeshes2 = domain2.boundaries()[b].interface().oriented_meshes();
+            if (domain1.boundaries()[b].inside()!=domain2.boundaries()[b].inside() || omeshes1.size()!=omeshes2.size())
+                return false;
+            for (size_t i=0;i<omeshes1.size();++i)
+                if (omeshes1[i].mesh().name()!=omeshes2[i].mesh().name() || omeshes1[i].orientation()!=omeshes2[i].orientation())
+                    return false;
+        }
+    }
+
+    return true;
+}
+
+bool check(const bool ok,const std::string& message) {
+    if (!ok)
+        std::cerr << message << std::endl;
+    return ok;
+}
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=5) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    //  Work on a copy of the data, as one of the meshes is modified.
+
+    const fs::path data(argv[1]);
+    const fs::path work  = "geometry_cache_test";
+    const fs::path cache = work/"cache";
+    fs::remove_all(work);
+    fs::create_directories(cache);
+    for (const auto& entry : fs::directory_iterator(data))
+        if (entry.is_regular_file())
+            fs::copy_file(entry.path(),work/entry.path().filename());
+
+    const std::string geom = (work/argv[2]).string();
+    const std::string cond = (work/argv[3]).string();
+
+    Geometry::cache_directory = "";
+    const Geometry reference(geom,cond);
+
+    Geometry::cache_directory = cache.string();
+    const Geometry first(geom,cond);
+
+    fs::path cache_file;
+    for (const auto& entry : fs::directory_iterator(cache))
+        cache_file = entry.path();
+
+    if (!check(!cache_file.empty(),"No cache file was written"))
+        return 1;
+
+    const auto time = fs::last_write_time(cache_file);
+    const auto size = fs::file_size(cache_file);
+
+    const Geometry second(geom,cond);
+
+    bool ok = check(same(reference,first),"Geometry differs after writing the cache") &&
+              check(same(reference,second),"Geometry restored from the cache differs") &&
+              check(fs::last_write_time(cache_file)==time,"Cache was rewritten for an unchanged geometry");
+
+    //  Modify one of the mesh files (which is not the first input), so that the cache is invalidated.
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::ofstream(work/argv[4],std::ios::app) << std::endl;
+
+    const Geometry third(geom,cond);
+
+    ok = check(same(reference,third),"Geometry differs after the invalidation of the cache") &&
+         check(fs::last_write_time(cache_file)!=time,"Cache was not rewritten after a change of a mesh") &&
+         check(fs::file_size(cache_file)==size,"Inputs of the rewritten cache differ") && ok;
+
+    fs::remove_all(work);
+
+    return (ok) ? 0 : 1;
+}
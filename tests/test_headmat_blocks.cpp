@@ -0,0 +1,104 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include <geometry.h>
+#include <assemble.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+
+    const HeadMatBlocks blocks(geo);
+
+    //  Change all the (non-zero) conductivities and recombine.
+
+    double scale = 0.3;
+    for (auto& domain : geo.domains())
+        if (domain.conductivity()!=0.0) {
+            domain.set_conductivity(domain.conductivity()*scale);
+            scale += 0.9;
+        }
+
+    const HeadMat H(geo);
+    bool ok = compare(HeadMat(geo,blocks),H,1e-12);
+
+    //  Save and reload the blocks (the file is named after the geometry, as several heads are tested concurrently).
+
+    const std::string filename = "test_headmat_blocks-"+std::filesystem::path(argv[1]).stem().string()+".blk";
+    blocks.save(filename);
+    HeadMatBlocks loaded;
+    loaded.load(filename,geo);
+    ok = compare(HeadMat(geo,loaded),H,1e-12) && ok;
+
+    //  The blocks are rejected for another integration order or for a geometry of same topology.
+
+    auto rejected = [&](const auto& function) {
+        try {
+            function();
+        } catch (const std::invalid_argument& e) {
+            std::cerr << "Rejected: " << e.what() << std::endl;
+            return true;
+        }
+        std::cerr << "Blocks not rejected" << std::endl;
+        return false;
+    };
+
+    ok = rejected([&]() { HeadMatBlocks other; other.load(filename,geo,2); }) && ok;
+    geo.vertices().front().x() += 1.0e-3;
+    ok = rejected([&]() { HeadMatBlocks other; other.load(filename,geo); }) && ok;
+    ok = rejected([&]() { HeadMat(geo,loaded); }) && ok;
+    std::remove(filename.c_str());
+
+    return (ok) ? 0 : 1;
+}
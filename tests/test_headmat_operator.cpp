@@ -0,0 +1,88 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+#include <cmath>
+
+#include <geometry.h>
+#include <assemble.h>
+#include <headmat_operator.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+
+    const HeadMat H(geo);
+    const HeadMatOperator op(geo);
+    const HeadMatOperator opcached(geo,3,2.0);
+    op.info();
+    opcached.info();
+
+    Matrix X(H.nlin(),3);
+    for (unsigned i=0;i<X.nlin();++i)
+        for (unsigned j=0;j<X.ncol();++j)
+            X(i,j) = cos(1.+i*(j+1));
+
+    const Matrix& HX = H*X;
+
+    Matrix D(H.nlin(),1);
+    for (unsigned i=0;i<H.nlin();++i)
+        D(i,0) = H(i,i);
+
+    Matrix opD(H.nlin(),1);
+    opD.setcol(0,op.diagonal());
+
+    Matrix opX0(H.nlin(),1);
+    opX0.setcol(0,op*X.getcol(0));
+
+    const bool ok = compare(op*X,HX,1e-10) && compare(opcached*X,HX,1e-10) &&
+                    compare(opX0,HX.submat(0,H.nlin(),0,1),1e-10) && compare(opD,D,1e-10);
+
+    return (ok) ? 0 : 1;
+}
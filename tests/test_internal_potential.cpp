@@ -0,0 +1,115 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+
+#include <geometry.h>
+#include <rectilinear_grid.h>
+#include <assemble.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+//  Checks the rectilinear grid mode of Surf2VolMat (domains found by ray casting, lines of the non-conductive
+//  points set to zero) against the point list mode, and the far field approximation against the exact operators.
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+
+    RectilinearGrid::Coordinates coords(11);
+    for (unsigned i=0;i<coords.size();++i)
+        coords[i] = -1.13+0.227*i;
+    const RectilinearGrid grid(coords,coords,coords);
+
+    grid.save("internal_grid.vtk");
+    const RectilinearGrid loaded("internal_grid.vtk");
+    if (loaded.nb_points()!=grid.nb_points() || (loaded.points()-grid.points()).frobenius_norm()>1e-12) {
+        std::cerr << "Error while saving/loading the grid" << std::endl;
+        return 1;
+    }
+
+    //  Domains.
+
+    const std::vector<const Domain*>& domains = grid.domains(geo);
+    std::vector<unsigned> conductive;
+    for (unsigned i=0;i<grid.nb_points();++i) {
+        const Domain& domain = geo.domain(grid.point(i));
+        if (&domain!=domains[i]) {
+            std::cerr << "Wrong domain for point " << grid.point(i) << ": " << domains[i]->name()
+                      << " instead of " << domain.name() << std::endl;
+            return 1;
+        }
+        if (domain.conductivity()!=0.0)
+            conductive.push_back(i);
+    }
+
+    //  Grid mode against point list mode.
+
+    Matrix points(conductive.size(),3);
+    for (unsigned i=0;i<conductive.size();++i)
+        for (unsigned j=0;j<3;++j)
+            points(i,j) = grid.point(conductive[i])(j);
+
+    const Surf2VolMat grid_mat(geo,grid);
+    const Surf2VolMat points_mat(geo,points);
+
+    Matrix selected(conductive.size(),grid_mat.ncol());
+    for (unsigned i=0;i<conductive.size();++i)
+        selected.setlin(i,grid_mat.getlin(conductive[i]));
+
+    const bool zero_lines = std::abs(grid_mat.frobenius_norm()-selected.frobenius_norm())<1e-12*grid_mat.frobenius_norm();
+    if (!zero_lines)
+        std::cerr << "Non-zero lines for non-conductive points" << std::endl;
+
+    //  Far field.
+
+    const Surf2VolMat far_mat(geo,grid,0.3);
+
+    const bool ok = zero_lines && compare(selected,points_mat,1e-12) && compare(far_mat,grid_mat,1e-5);
+
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <filesystem>
+#include <iostream>
+
+#include <geometry.h>
+#include <matrix_cache.h>
+
+using namespace OpenMEEG;
+
+//  Checks that a matrix is read from the cache (OPENMEEG_CACHE_DIR) when the geometry is unchanged, and that
+//  changing the orientation of a mesh in an interface invalidates the entry.
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    if (MatrixCache::directory.empty()) {
+        std::cerr << "OPENMEEG_CACHE_DIR is not set" << std::endl;
+        return 1;
+    }
+    std::filesystem::remove_all(MatrixCache::directory);
+
+    Geometry geo(argv[1],argv[2]);
+
+    unsigned builds = 0;
+    auto fetch = [&]() {
+        MatrixCache cache("TestMatrix");
+        cache << geo << 3u;
+        return cache.fetch<Matrix>([&]() {
+            Matrix M(1,1);
+            M(0,0) = ++builds;
+            return M;
+        });
+    };
+
+    const Matrix& first  = fetch();
+    const Matrix& second = fetch();
+
+    bool ok = builds==1 && second(0,0)==first(0,0);
+    if (!ok)
+        std::cerr << "The matrix was not read from the cache" << std::endl;
+
+    geo.domains().front().boundaries().front().interface().oriented_meshes().front().change_orientation();
+    fetch();
+
+    if (builds!=2) {
+        std::cerr << "The cache entry was not invalidated by a change of orientation" << std::endl;
+        ok = false;
+    }
+
+    std::filesystem::remove_all(MatrixCache::directory);
+
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+
+#include <geometry.h>
+#include <sensors.h>
+#include <assemble.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+//  Checks that the MEG matrices of coils made of several weighted integration points (folded on the fly) are
+//  equal to the weighted sums of the matrices computed for each integration point as a separate sensor.
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=5) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+    const Sensors squids(argv[3]);
+    const Matrix  dipoles(argv[4]);
+
+    //  Each squid becomes an axial gradiometer with two points. The second points of all coils are written after
+    //  the first ones, so that the points of a coil are not contiguous in the file.
+
+    const Matrix& positions    = squids.getPositions();
+    const Matrix& orientations = squids.getOrientations();
+    const size_t  n            = positions.nlin();
+    const double  baseline     = 0.05;
+    const double  weights[2]   = { 1.0, -0.8 };
+
+    //  The sensor files are written in a private temporary directory, removed at the end.
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path()/
+                                      ("test_sensor_coils-"+std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(dir);
+    const std::string points_file = (dir/"coil_points.squids").string();
+    const std::string coils_file  = (dir/"coils.squids").string();
+
+    std::ofstream points(points_file);
+    std::ofstream coils(coils_file);
+    points << std::fixed << std::setprecision(12);
+    coils  << std::fixed << std::setprecision(12);
+    SparseMatrix::Builder builder(n,2*n);
+    for (unsigned k=0;k<2;++k)
+        for (size_t i=0;i<n;++i) {
+            coils << "COIL" << i;
+            for (unsigned c=0;c<3;++c) {
+                points << ' ' << positions(i,c)+k*baseline*orientations(i,c);
+                coils  << ' ' << positions(i,c)+k*baseline*orientations(i,c);
+            }
+            for (unsigned c=0;c<3;++c) {
+                points << ' ' << orientations(i,c);
+                coils  << ' ' << orientations(i,c);
+            }
+            points << std::endl;
+            coils  << ' ' << weights[k] << std::endl;
+            builder.insert(i,k*n+i,weights[k]);
+        }
+    points.close();
+    coils.close();
+
+    const Sensors point_sensors(points_file.c_str());
+    const Sensors coil_sensors(coils_file.c_str());
+    const SparseMatrix W(builder);
+    std::filesystem::remove_all(dir);
+
+    if (coil_sensors.getNumberOfSensors()!=n || coil_sensors.getNumberOfPositions()!=2*n) {
+        std::cerr << "Wrong number of coils or of integration points" << std::endl;
+        return 1;
+    }
+
+    const bool ok = compare(Head2MEGMat(geo,coil_sensors),W*Head2MEGMat(geo,point_sensors),1e-12) &&
+                    compare(DipSource2MEGMat(dipoles,coil_sensors),W*DipSource2MEGMat(dipoles,point_sensors),1e-12);
+
+    return (ok) ? 0 : 1;
+}
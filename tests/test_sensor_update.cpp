@@ -0,0 +1,92 @@
+/*
+Project Name: OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+
+#include <geometry.h>
+#include <sensors.h>
+#include <assemble.h>
+#include <gain.h>
+
+#include "test_utils.hpp"
+
+using namespace OpenMEEG;
+
+//  Checks that after a re-registration of some squids, the partially recomputed Head2MEGMat is equal to the one
+//  computed from scratch, and that the gains obtained from the source solutions are equal to the adjoint gains.
+
+int
+main(int argc,char** argv) {
+
+    if (argc!=6) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+    const Sensors squids(argv[3]);
+    const Sensors electrodes(argv[4]);
+    const Matrix  dipoles(argv[5]);
+
+    //  Move the integration points of a few squids (the others are unchanged).
+
+    Sensors moved_squids(argv[3]);
+    Matrix& positions = moved_squids.getPositions();
+    for (size_t i=0;i<positions.nlin();i+=5)
+        for (unsigned c=0;c<3;++c)
+            positions(i,c) += 0.01*(c+1);
+
+    const Head2MEGMat previous(geo,squids);
+    const Head2MEGMat updated(geo,moved_squids,squids,previous);
+    const Head2MEGMat full(geo,moved_squids);
+
+    bool ok = compare(updated,full,1e-12);
+
+    //  Gains of the moved squids from the source solutions.
+
+    const HeadMat HM(geo);
+    const SourceSolutions X(HM,DipSourceMat(geo,dipoles));
+    const Matrix& DS2MM = DipSource2MEGMat(dipoles,moved_squids);
+    const Head2EEGMat H2EM(geo,electrodes);
+
+    ok = compare(GainMEG(X,updated,DS2MM),GainMEGadjoint(geo,dipoles,HM,full,DS2MM),1e-8) && ok;
+    ok = compare(GainEEG(X,H2EM),GainEEGadjoint(geo,dipoles,HM,H2EM),1e-8) && ok;
+
+    return (ok) ? 0 : 1;
+}
@@ -1,12 +1,5 @@
-/* FILE: $Id: fast_sparse_matrix.h 284 2008-07-24 21:56:52Z gramfort $ */
-
 /*
-Project Name : OpenMEEG
-
-version           : $Revision: 284 $
-last revision     : $Date: 2008-07-24 23:56:52 +0200 (jeu., 24 juil. 2008) $
-modified by       : $LastChangedBy: gramfort $
-last modified     : $LastChangedDate: 2008-07-24 23:56:52 +0200 (jeu., 24 juil. 2008) $
+Project Name: OpenMEEG
 
 © INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
 GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
@@ -44,4 +37,23 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
-#include "fast_sparse_matrix.h"
+#pragma once
+
+#include <iostream>
+
+#include <matrix.h>
+
+namespace OpenMEEG {
+
+    //  Relative (Frobenius) error of M1 with respect to M2. The matrices may be of any type convertible to Matrix
+    //  (e.g. SymMatrix or the assembled operators).
+
+    template <typename MATRIX1,typename MATRIX2>
+    bool compare(const MATRIX1& M1,const MATRIX2& M2,const double eps) {
+        const Matrix& A = Matrix(M1);
+        const Matrix& B = Matrix(M2);
+        const double err = (A-B).frobenius_norm()/B.frobenius_norm();
+        std::cerr << "Relative error: " << err << std::endl;
+        return err<eps;
+    }
+}
@@ -128,7 +128,7 @@ main(const int argc,const char* argv[]) {
     Vect3 current_position; // buffer for electrodes positions
     Vect3 current_alphas;
     Triangle current_nearest_triangle; // buffer for closest triangle to electrode
-    SparseMatrix matH2E(electrodes.getNumberOfSensors(), newsize); // Matrices Head2Electrodes
+    SparseMatrix::Builder H2E(electrodes.getNumberOfSensors(), newsize); // Matrices Head2Electrodes
 
     // Find the triangle closest to the electrodes
     for (unsigned ielec=0;ielec<nelec;++ielec) {
@@ -136,8 +136,9 @@ main(const int argc,const char* argv[]) {
             current_position(k) = electrodes_positions(ielec, k);
         dist_point_interface(current_position, geo.outermost_interface(), current_alphas, current_nearest_triangle);
         for (unsigned k=0;k<3;++k)
-            matH2E(ielec,current_nearest_triangle.vertex(k).index()) = current_alphas(k);
+            H2E.insert(ielec,current_nearest_triangle.vertex(k).index(),current_alphas(k));
     }
+    const SparseMatrix matH2E(H2E);
 
     // Potential at the electrodes positions
     const Vector& VRi = (matH2E * PotExt).getlin(0);
@@ -36,6 +36,7 @@
     #include <mesh.h>
     #include <interface.h>
     #include <domain.h>
+    #include <rectilinear_grid.h>
     #include <assemble.h>
     #include <gain.h>
     #include <forward.h>
@@ -569,6 +570,7 @@ namespace OpenMEEG {
 %include <mesh.h>
 %include <interface.h>
 %include <domain.h>
+%include <rectilinear_grid.h>
 %include <assemble.h>
 %include <gain.h>
 %include <forward.h>